@@ -0,0 +1,650 @@
+/*******************************************************************************
+ ** Name: bench
+ ** Purpose: Measures blackbox's hot paths, to catch regressions in its engine.
+ ** Author: (JE) Jens Elstner <jens.elstner@bka.bund.de>
+ *******************************************************************************
+ ** Date        User  Log
+ **-----------------------------------------------------------------------------
+ ** 16.10.2026  JE    Created program.
+ ** 16.10.2026  JE    Added 'moveAtom' for the beam cache.
+ ** 16.10.2026  JE    Added 'walkSparse' for sparse boards.
+ ** 16.10.2026  JE    Added 'walkBeams' and a check of its exits against
+ **                   walkGrid() on grids between guard pages.
+ ** 16.10.2026  JE    Added 'walkGrids' for batches of boards like the solver's
+ **                   candidates, checked like 'walkBeams'.
+ *******************************************************************************/
+
+
+//******************************************************************************
+//* includes & namespaces
+
+#include <fcntl.h>
+
+// The game's own main() gives way to the benchmark's.
+#define main blackboxMain
+#include "main.c"
+#undef main
+
+
+//******************************************************************************
+//* defines & macros
+
+#define BENCH_VERSION "0.5.0"
+
+#define BENCH_REPS    7         // Default count of timed repetitions.
+#define BENCH_REP_MS  20        // Default minimal time of one repetition.
+#define BENCH_CELLS   4096      // Count of random cells per lookAhead() run.
+#define CHECK_BOARDS  16        // Random boards per size and density checked.
+
+
+//******************************************************************************
+//* typedefs
+
+// Options of the benchmark.
+typedef struct s_bench {
+  int  iReps;
+  int  iRepMs;
+  ll   llSeed;
+  cstr csFilter;  // Only benchmarks starting with this name, if any.
+} t_bench;
+
+// A benchmark runs iOps operations per call and returns a checksum.
+typedef ll (*t_benchFcn)(t_board* ptBoard, t_rand* ptRand, ll llOps);
+
+
+//******************************************************************************
+//* Global variables
+
+t_bench g_tBench;
+int     g_aiSizes[]      = {8, 16, 32, 64, 128, 256};
+int     g_aiDensities[]  = {1, 5, 10};  // Atoms in percent of inner cells.
+int     g_aiCheckSizes[] = {1, 2, 3, 5, 8, 13, 31, 32, 33, 64, 100, 200, 256};
+int*    g_paiCells;                     // Random inner cells for lookAhead().
+int*    g_paiDirs;                      // Random directions for lookAhead().
+ll      g_llSink;                       // Keeps the compiler from idling.
+
+
+//******************************************************************************
+//* Functions
+
+/*******************************************************************************
+ * Name:  getNs
+ * Purpose: Returns monotonic time in nano seconds.
+ *******************************************************************************/
+ll getNs(void) {
+  struct timespec tTs;
+
+  clock_gettime(CLOCK_MONOTONIC, &tTs);
+
+  return (ll) tTs.tv_sec * 1000000000LL + (ll) tTs.tv_nsec;
+}
+
+/*******************************************************************************
+ * Name:  benchWalkGrid
+ * Purpose: One operation is one beam walked on the grid.
+ *******************************************************************************/
+ll benchWalkGrid(t_board* ptBoard, t_rand* ptRand, ll llOps) {
+  int iNodes = 4 * ptBoard->iSize;
+  int iCell  = 0;
+  int iDir   = 0;
+  ll  llSum  = 0;
+
+  for (ll i = 0; i < llOps; ++i) {
+    getEdgeCell(ptBoard, (int) (i % iNodes) + 1, &iCell, &iDir);
+    llSum += walkGrid(ptBoard, iCell, iDir);
+  }
+
+  return llSum;
+}
+
+/*******************************************************************************
+ * Name:  benchWalkBeams
+ * Purpose: One operation is one beam walked by walkBeams(), all beams of the
+ *          board at once.
+ *******************************************************************************/
+ll benchWalkBeams(t_board* ptBoard, t_rand* ptRand, ll llOps) {
+  int iBeams = 4 * ptBoard->iSize;
+  ll  llSum  = 0;
+
+  for (int iBeam = 1; iBeam <= iBeams; ++iBeam)
+    getEdgeCell(ptBoard, iBeam, &ptBoard->paiEntries[iBeam], &ptBoard->paiDirs[iBeam]);
+
+  for (ll i = 0; i < llOps; i += iBeams) {
+    walkBeams(ptBoard, &ptBoard->paiEntries[1], &ptBoard->paiDirs[1], &ptBoard->paiOuts[1], iBeams);
+    llSum += ptBoard->paiOuts[1];
+  }
+
+  return llSum;
+}
+
+/*******************************************************************************
+ * Name:  benchWalkGrids
+ * Purpose: One operation is one beam walked by walkGrids(), all beams of a
+ *          batch of random boards at once, like the advisor rates candidates.
+ *******************************************************************************/
+ll benchWalkGrids(t_board* ptBoard, t_rand* ptRand, ll llOps) {
+  int  iBeams   = 4 * ptBoard->iSize;
+  int  iGrids   = batchGrids(ptBoard);
+  int  iWalks   = iGrids * iBeams;
+  int* paiGrids = createGrids(ptBoard, iGrids);
+  int* paiCells = (int*) malloc(sizeof(int) * (size_t) iWalks);
+  int* paiDirs  = (int*) malloc(sizeof(int) * (size_t) iWalks);
+  int* paiOuts  = (int*) malloc(sizeof(int) * (size_t) iWalks);
+  ll   llSum    = 0;
+
+  for (int g = 0; g < iGrids; ++g) {
+    createBoard(ptBoard, ptRand);
+    memcpy(&paiGrids[g * ptBoard->iCellNo], ptBoard->paiGrid, sizeof(int) * (size_t) ptBoard->iCellNo);
+    for (int iBeam = 1; iBeam <= iBeams; ++iBeam) {
+      getEdgeCell(ptBoard, iBeam, &paiCells[g * iBeams + iBeam - 1], &paiDirs[g * iBeams + iBeam - 1]);
+      paiCells[g * iBeams + iBeam - 1] += g * ptBoard->iCellNo;
+    }
+  }
+
+  for (ll i = 0; i < llOps; i += iWalks) {
+    walkGrids(ptBoard, paiGrids, iGrids, paiCells, paiDirs, paiOuts, iWalks);
+    llSum += paiOuts[0];
+  }
+
+  free(paiGrids);
+  free(paiCells);
+  free(paiDirs);
+  free(paiOuts);
+
+  return llSum;
+}
+
+/*******************************************************************************
+ * Name:  benchWalkBits
+ * Purpose: One operation is one beam walked on the bitmasks.
+ *******************************************************************************/
+ll benchWalkBits(t_board* ptBoard, t_rand* ptRand, ll llOps) {
+  int iNodes = 4 * ptBoard->iSize;
+  int iCell  = 0;
+  int iDir   = 0;
+  ll  llSum  = 0;
+
+  for (ll i = 0; i < llOps; ++i) {
+    getEdgeCell(ptBoard, (int) (i % iNodes) + 1, &iCell, &iDir);
+    llSum += walkBits(ptBoard, iCell, iDir);
+  }
+
+  return llSum;
+}
+
+/*******************************************************************************
+ * Name:  benchWalkSparse
+ * Purpose: One operation is one beam walked on the board's atoms kept sparse.
+ *          Sorting the atoms is spread over the operations.
+ *******************************************************************************/
+ll benchWalkSparse(t_board* ptBoard, t_rand* ptRand, ll llOps) {
+  t_sparse tSp    = {0};
+  int      iNodes = 4 * ptBoard->iSize;
+  int      iX     = 0;
+  int      iY     = 0;
+  ll       llSum  = 0;
+
+  initSparse(&tSp, ptBoard->iSize, ptBoard->iAtomsSet);
+  for (int i = 0; i < ptBoard->iAtomsSet; ++i) {
+    cellToXY(ptBoard, ptBoard->paiAtoms[i], &iX, &iY);
+    tSp.paullRows[i] = (uint64_t) iY << 32 | (uint64_t) iX;
+    tSp.paullCols[i] = (uint64_t) iX << 32 | (uint64_t) iY;
+  }
+  tSp.iAtomsSet = ptBoard->iAtomsSet;
+  qsort(tSp.paullRows, (size_t) tSp.iAtomsSet, sizeof(uint64_t), compareU64);
+  qsort(tSp.paullCols, (size_t) tSp.iAtomsSet, sizeof(uint64_t), compareU64);
+
+  for (ll i = 0; i < llOps; ++i)
+    llSum += walkSparse(&tSp, (int) (i % iNodes) + 1);
+
+  freeSparse(&tSp);
+
+  return llSum;
+}
+
+/*******************************************************************************
+ * Name:  benchLookAhead
+ * Purpose: One operation is one look ahead from a random inner cell.
+ *******************************************************************************/
+ll benchLookAhead(t_board* ptBoard, t_rand* ptRand, ll llOps) {
+  ll llSum = 0;
+
+  for (ll i = 0; i < llOps; ++i)
+    llSum += lookAhead(ptBoard, g_paiCells[i % BENCH_CELLS], g_paiDirs[i % BENCH_CELLS]);
+
+  return llSum;
+}
+
+/*******************************************************************************
+ * Name:  benchCreateBoard
+ * Purpose: One operation is one new board with all its atoms.
+ *******************************************************************************/
+ll benchCreateBoard(t_board* ptBoard, t_rand* ptRand, ll llOps) {
+  ll llSum = 0;
+
+  for (ll i = 0; i < llOps; ++i) {
+    createBoard(ptBoard, ptRand);
+    llSum += ptBoard->paiAtoms[0];
+  }
+
+  return llSum;
+}
+
+/*******************************************************************************
+ * Name:  benchExitTable
+ * Purpose: One operation is the exit table of the board, all beams walked.
+ *******************************************************************************/
+ll benchExitTable(t_board* ptBoard, t_rand* ptRand, ll llOps) {
+  ll llSum = 0;
+
+  for (ll i = 0; i < llOps; ++i) {
+    createExitTable(ptBoard);
+    llSum += ptBoard->paiExits[1];
+  }
+
+  return llSum;
+}
+
+/*******************************************************************************
+ * Name:  benchMoveAtom
+ * Purpose: One operation is one atom moved to a random empty cell and the
+ *          exit table updated by the beam cache. Setting up the cache is
+ *          spread over the operations.
+ *******************************************************************************/
+ll benchMoveAtom(t_board* ptBoard, t_rand* ptRand, ll llOps) {
+  t_beamCache tCache = {0};
+  ll          llSum  = 0;
+  int         iAtom  = 0;
+  int         iCell  = 0;
+
+  initBeamCache(&tCache, ptBoard);
+  updateExitTable(&tCache, ptBoard);
+
+  for (ll i = 0; i < llOps; ++i) {
+    iAtom = (int) randBelow(ptRand, (uint64_t) ptBoard->iAtomsSet);
+    do
+      cellFromXY(ptBoard, &iCell, (int) randBelow(ptRand, (uint64_t) ptBoard->iSize) + 1,
+                                  (int) randBelow(ptRand, (uint64_t) ptBoard->iSize) + 1);
+    while (ptBoard->paiGrid[iCell] == CELL_ATOM);
+
+    setCachedAtom(&tCache, ptBoard, ptBoard->paiAtoms[iAtom], 0);
+    setCachedAtom(&tCache, ptBoard, iCell, 1);
+    ptBoard->paiAtoms[iAtom] = iCell;
+    updateExitTable(&tCache, ptBoard);
+    llSum += ptBoard->paiExits[1];
+  }
+
+  freeBeamCache(&tCache);
+
+  return llSum;
+}
+
+/*******************************************************************************
+ * Name:  benchPrintBoard
+ * Purpose: One operation is one board printed with its solution.
+ *******************************************************************************/
+ll benchPrintBoard(t_board* ptBoard, t_rand* ptRand, ll llOps) {
+  for (ll i = 0; i < llOps; ++i)
+    printBoard(ptBoard, BOARD_SOLUTION, NULL);
+
+  return llOps;
+}
+
+/*******************************************************************************
+ * Name:  compareDouble
+ * Purpose: Compares two doubles for qsort().
+ *******************************************************************************/
+int compareDouble(const void* pvA, const void* pvB) {
+  double dA = *(const double*) pvA;
+  double dB = *(const double*) pvB;
+
+  return (dA > dB) - (dA < dB);
+}
+
+/*******************************************************************************
+ * Name:  runBench
+ * Purpose: Warms up and calibrates the count of operations per repetition,
+ *          then times all repetitions and prints their statistics as one line.
+ *          Rendering goes to '/dev/null', so only the results are printed.
+ *******************************************************************************/
+void runBench(const char* pcName, t_benchFcn fcnBench, int iSize, int iAtomNo, int bBitboard, int bMute) {
+  t_board tBoard  = {0};
+  t_rand  tRand   = {0};
+  ll      llOps   = 1;
+  ll      llStart = 0;
+  ll      llTime  = 0;
+  ll      llMinNs = (ll) g_tBench.iRepMs * 1000000LL;
+  double* padNs   = NULL;
+  double  dMean   = 0.0;
+  double  dVar    = 0.0;
+  int     iStdout = -1;
+  int     iNull   = -1;
+
+  if (g_tBench.csFilter.len != 0 && strncmp(pcName, g_tBench.csFilter.cStr, (size_t) g_tBench.csFilter.len) != 0)
+    return;
+
+  randSeed(&tRand, (uint64_t) g_tBench.llSeed);
+  initBoard(&tBoard, iSize, iAtomNo, bBitboard);
+  createBoard(&tBoard, &tRand);
+  createExitTable(&tBoard);
+
+  // Random inner cells and directions, the same for each size.
+  for (int i = 0; i < BENCH_CELLS; ++i) {
+    cellFromXY(&tBoard, &g_paiCells[i], (int) randBelow(&tRand, (uint64_t) iSize) + 1,
+                                        (int) randBelow(&tRand, (uint64_t) iSize) + 1);
+    g_paiDirs[i] = (int) randBelow(&tRand, 4) + 1;
+  }
+
+  if (bMute) {
+    fflush(stdout);
+    iStdout = dup(STDOUT_FILENO);
+    iNull   = open("/dev/null", O_WRONLY);
+    dup2(iNull, STDOUT_FILENO);
+  }
+
+  // Warm up caches and double the operations till one run takes long enough.
+  while (1) {
+    llStart   = getNs();
+    g_llSink += fcnBench(&tBoard, &tRand, llOps);
+    llTime    = getNs() - llStart;
+    if (llTime >= llMinNs)
+      break;
+    llOps *= 2;
+  }
+
+  padNs = (double*) malloc(sizeof(double) * (size_t) g_tBench.iReps);
+  for (int r = 0; r < g_tBench.iReps; ++r) {
+    llStart   = getNs();
+    g_llSink += fcnBench(&tBoard, &tRand, llOps);
+    padNs[r]  = (double) (getNs() - llStart) / (double) llOps;
+  }
+
+  if (bMute) {
+    fflush(stdout);
+    dup2(iStdout, STDOUT_FILENO);
+    close(iStdout);
+    close(iNull);
+  }
+
+  for (int r = 0; r < g_tBench.iReps; ++r)
+    dMean += padNs[r] / g_tBench.iReps;
+  for (int r = 0; r < g_tBench.iReps; ++r)
+    dVar  += (padNs[r] - dMean) * (padNs[r] - dMean) / g_tBench.iReps;
+  qsort(padNs, (size_t) g_tBench.iReps, sizeof(double), compareDouble);
+
+  printf("%-16s %4d %6d %3d %10lld %12.2f %12.2f %12.2f %10.2f %14.0f\n",
+         pcName, iSize, iAtomNo, g_tBench.iReps, llOps,
+         padNs[0], padNs[g_tBench.iReps / 2], dMean, sqrt(dVar), 1e9 / padNs[g_tBench.iReps / 2]);
+  fflush(stdout);
+
+  free(padNs);
+  freeBoard(&tBoard);
+}
+
+/*******************************************************************************
+ * Name:  mapGuarded
+ * Purpose: Copies a grid into a mapping between two pages which can't be read,
+ *          right behind the first or right before the last, so reading off
+ *          the grid faults.
+ *******************************************************************************/
+int* mapGuarded(const int* paiGrid, int iCells, int bAtEnd, uint8_t** ppucMap, size_t* psMap) {
+  size_t   sPage  = (size_t) sysconf(_SC_PAGESIZE);
+  size_t   sBytes = sizeof(int) * (size_t) iCells;
+  size_t   sData  = (sBytes + sPage - 1) / sPage * sPage;
+  uint8_t* pucMap = NULL;
+  int*     paiRv  = NULL;
+
+  *psMap = sData + 2 * sPage;
+  pucMap = (uint8_t*) mmap(NULL, *psMap, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (pucMap == MAP_FAILED || mprotect(pucMap + sPage, sData, PROT_READ | PROT_WRITE) != 0)
+    dispatchError(ERR_ELSE, "Can't map guarded grid");
+
+  paiRv = (int*) (pucMap + sPage + (bAtEnd ? sData - sBytes : 0));
+  memcpy(paiRv, paiGrid, sBytes);
+  *ppucMap = pucMap;
+
+  return paiRv;
+}
+
+/*******************************************************************************
+ * Name:  checkWalkBeams
+ * Purpose: Checks walkBeams() against walkGrid() on random boards, with the
+ *          grid between guard pages, so lanes looking off the grid fault
+ *          even where the gathers aren't checked by sanitizers. Then all
+ *          boards of a size and density walk at once by walkGrids(), their
+ *          grids between guard pages, too. Exits on the first beam differing.
+ *******************************************************************************/
+void checkWalkBeams(void) {
+  t_board  tBoard   = {0};
+  t_rand   tRand    = {0};
+  int*     paiGrid  = NULL;
+  int*     paiWant  = NULL;
+  int*     paiGrids = NULL;
+  int*     paiCells = NULL;
+  int*     paiDirs  = NULL;
+  int*     paiOuts  = NULL;
+  uint8_t* pucMap   = NULL;
+  size_t   sMap     = 0;
+  int      iSize    = 0;
+  int      iAtomNo  = 0;
+  int      iBeams   = 0;
+  int      iGrids   = 2 * CHECK_BOARDS;
+  int      iWalk    = 0;
+  int      iWant    = 0;
+  ll       llBeams  = 0;
+  ll       llBatch  = 0;
+
+  randSeed(&tRand, (uint64_t) g_tBench.llSeed);
+
+  for (size_t s = 0; s < arraySize(g_aiCheckSizes); ++s) {
+    for (size_t d = 0; d < arraySize(g_aiDensities); ++d) {
+      iSize   = g_aiCheckSizes[s];
+      iBeams  = 4 * iSize;
+      iAtomNo = iSize * iSize * g_aiDensities[d] / 100;
+      if (iAtomNo < 1)
+        iAtomNo = 1;
+
+      initBoard(&tBoard, iSize, iAtomNo, 0);
+      paiWant  = (int*) realloc(paiWant,  sizeof(int) * (size_t) (iGrids * iBeams + 1));
+      paiGrids = (int*) realloc(paiGrids, sizeof(int) * (size_t) (iGrids * tBoard.iCellNo));
+      paiCells = (int*) realloc(paiCells, sizeof(int) * (size_t) (iGrids * iBeams));
+      paiDirs  = (int*) realloc(paiDirs,  sizeof(int) * (size_t) (iGrids * iBeams));
+      paiOuts  = (int*) realloc(paiOuts,  sizeof(int) * (size_t) (iGrids * iBeams));
+
+      for (int b = 0; b < iGrids; ++b) {
+        createBoard(&tBoard, &tRand);
+        memcpy(&paiGrids[b * tBoard.iCellNo], tBoard.paiGrid, sizeof(int) * (size_t) tBoard.iCellNo);
+        for (int iBeam = 1; iBeam <= iBeams; ++iBeam) {
+          getEdgeCell(&tBoard, iBeam, &tBoard.paiEntries[iBeam], &tBoard.paiDirs[iBeam]);
+          paiWant[iBeam] = walkGrid(&tBoard, tBoard.paiEntries[iBeam], tBoard.paiDirs[iBeam]);
+
+          // Last boards' beams first, so lanes mix the grids.
+          iWalk = (iGrids - 1 - b) * iBeams + iBeam - 1;
+          paiCells[iWalk] = b * tBoard.iCellNo + tBoard.paiEntries[iBeam];
+          paiDirs[iWalk]  = tBoard.paiDirs[iBeam];
+          paiOuts[iWalk]  = (paiWant[iBeam] == 0) ? 0 : b * tBoard.iCellNo + paiWant[iBeam];
+        }
+
+        // Guard page before the grid for half the boards, behind it for the
+        // other half.
+        paiGrid        = tBoard.paiGrid;
+        tBoard.paiGrid = mapGuarded(paiGrid, tBoard.iCellNo, b % 2, &pucMap, &sMap);
+        walkBeams(&tBoard, &tBoard.paiEntries[1], &tBoard.paiDirs[1], &tBoard.paiOuts[1], iBeams);
+        munmap(pucMap, sMap);
+        tBoard.paiGrid = paiGrid;
+
+        for (int iBeam = 1; iBeam <= iBeams; ++iBeam)
+          if (tBoard.paiOuts[iBeam] != paiWant[iBeam]) {
+            fprintf(stderr, "walkBeams() differs from walkGrid() on size %d, atoms %d, beam %d: %d instead of %d\n",
+                    iSize, iAtomNo, iBeam, tBoard.paiOuts[iBeam], paiWant[iBeam]);
+            exit(ERR_ELSE);
+          }
+        llBeams += iBeams;
+      }
+
+      // Exits wanted are kept in paiOuts, so walk into paiWant.
+      paiGrid = mapGuarded(paiGrids, iGrids * tBoard.iCellNo, iSize % 2, &pucMap, &sMap);
+      walkGrids(&tBoard, paiGrid, iGrids, paiCells, paiDirs, paiWant, iGrids * iBeams);
+      munmap(pucMap, sMap);
+
+      for (int w = 0; w < iGrids * iBeams; ++w) {
+        iWant = paiOuts[w];
+        if (paiWant[w] != iWant) {
+          fprintf(stderr, "walkGrids() differs from walkGrid() on size %d, atoms %d, walk %d: %d instead of %d\n",
+                  iSize, iAtomNo, w, paiWant[w], iWant);
+          exit(ERR_ELSE);
+        }
+      }
+      llBatch += iGrids * iBeams;
+    }
+  }
+
+  printf("# walkBeams equal to walkGrid on %lld beams, grids between guard pages\n", llBeams);
+  printf("# walkGrids equal to walkGrid on %lld beams, batches of %d grids\n", llBatch, iGrids);
+
+  free(paiWant);
+  free(paiGrids);
+  free(paiCells);
+  free(paiDirs);
+  free(paiOuts);
+  freeBoard(&tBoard);
+}
+
+/*******************************************************************************
+ * Name:  benchUsage
+ * Purpose: Print help text and exit program.
+ *******************************************************************************/
+void benchUsage(int iErr, const char* pcMsg) {
+  FILE* hOut = (iErr == ERR_NOERR) ? stdout : stderr;
+
+  if (pcMsg[0] != '\0')
+    fprintf(hOut, "%s\n", pcMsg);
+
+  fprintf(hOut,
+//|************************ 80 chars width ****************************************|
+  "usage: %s [-r n] [-t ms] [--seed n] [name]\n"
+  "       %s [-h|--help|-v|--version]\n"
+  " Measures blackbox's hot paths over board sizes 8 to 256 and atom densities\n"
+  " of 1, 5 and 10 percent. Each benchmark is warmed up and calibrated first,\n"
+  " then timed in repetitions. Each result is one line with whitespace separated\n"
+  " columns, comment lines start with '#':\n"
+  "   name size atoms reps ops min_ns median_ns mean_ns sd_ns ops_per_s\n"
+  " where each ns column is the time of one operation. First walkBeams() and\n"
+  " walkGrids() are checked to walk all beams like walkGrid(), on grids between\n"
+  " guard pages.\n"
+  " \n"
+  "  -r n:          count of timed repetitions (default %d)\n"
+  "  -t ms:         minimal time of one repetition (default %d)\n"
+  "  --seed n:      seed of the random boards (default 1)\n"
+  "  name:          run only benchmarks whose name starts with name\n"
+  "  -h|--help:     print this help\n"
+  "  -v|--version:  print version of program\n"
+//|************************ 80 chars width ****************************************|
+         , g_csMename.cStr, g_csMename.cStr, BENCH_REPS, BENCH_REP_MS);
+
+  exit(iErr);
+}
+
+/*******************************************************************************
+ * Name:  getBenchOptions
+ * Purpose: Filters options and arguments from command line.
+ *******************************************************************************/
+void getBenchOptions(int argc, char* argv[]) {
+  cstr csArgv = csNew("");
+  int  iArg   = 1;
+
+  // Set defaults.
+  g_tBench.iReps    = BENCH_REPS;
+  g_tBench.iRepMs   = BENCH_REP_MS;
+  g_tBench.llSeed   = 1;
+  g_tBench.csFilter = csNew("");
+
+  while (iArg < argc) {
+    shift(&csArgv, &iArg, argc, argv);
+
+    if (!strcmp(csArgv.cStr, "-h") || !strcmp(csArgv.cStr, "--help"))
+      benchUsage(ERR_NOERR, "");
+    if (!strcmp(csArgv.cStr, "-v") || !strcmp(csArgv.cStr, "--version")) {
+      printf("%s %s\n", g_csMename.cStr, BENCH_VERSION);
+      exit(ERR_NOERR);
+    }
+    if (!strcmp(csArgv.cStr, "-r")) {
+      if (! getArgInt(&g_tBench.iReps, &iArg, argc, argv, ARG_CLI, NULL) || g_tBench.iReps < 1)
+        benchUsage(ERR_ARGS, "No valid count of repetitions or missing");
+      continue;
+    }
+    if (!strcmp(csArgv.cStr, "-t")) {
+      if (! getArgInt(&g_tBench.iRepMs, &iArg, argc, argv, ARG_CLI, NULL) || g_tBench.iRepMs < 0)
+        benchUsage(ERR_ARGS, "No valid time or missing");
+      continue;
+    }
+    if (!strcmp(csArgv.cStr, "--seed")) {
+      if (! getArgLong(&g_tBench.llSeed, &iArg, argc, argv, ARG_CLI, NULL))
+        benchUsage(ERR_ARGS, "No valid seed or missing");
+      continue;
+    }
+    if (csArgv.cStr[0] == '-')
+      benchUsage(ERR_ARGS, "Invalid option");
+
+    csSet(&g_tBench.csFilter, csArgv.cStr);
+  }
+
+  csFree(&csArgv);
+}
+
+
+//******************************************************************************
+//* main
+
+int main(int argc, char *argv[]) {
+  int iSize   = 0;
+  int iAtomNo = 0;
+
+  // Save program's name.
+  g_csMename = csNew("");
+  getMename(&g_csMename, argv[0]);
+
+  getBenchOptions(argc, argv);
+
+  g_paiCells = (int*) malloc(sizeof(int) * BENCH_CELLS);
+  g_paiDirs  = (int*) malloc(sizeof(int) * BENCH_CELLS);
+
+  printf("# %s %s, blackbox %s, reps %d, min rep time %d ms, seed %lld\n",
+         g_csMename.cStr, BENCH_VERSION, ME_VERSION, g_tBench.iReps, g_tBench.iRepMs, g_tBench.llSeed);
+  checkWalkBeams();
+  printf("# name size atoms reps ops min_ns median_ns mean_ns sd_ns ops_per_s\n");
+
+  // Beams and boards over all sizes and densities.
+  for (size_t s = 0; s < arraySize(g_aiSizes); ++s) {
+    for (size_t d = 0; d < arraySize(g_aiDensities); ++d) {
+      iSize   = g_aiSizes[s];
+      iAtomNo = iSize * iSize * g_aiDensities[d] / 100;
+      if (iAtomNo < 1)
+        iAtomNo = 1;
+
+      runBench("walkGrid",        benchWalkGrid,    iSize, iAtomNo, 0, 0);
+      runBench("walkBeams",       benchWalkBeams,   iSize, iAtomNo, 0, 0);
+      runBench("walkGrids",       benchWalkGrids,   iSize, iAtomNo, 0, 0);
+      runBench("walkBits",        benchWalkBits,    iSize, iAtomNo, 1, 0);
+      runBench("walkSparse",      benchWalkSparse,  iSize, iAtomNo, 0, 0);
+      runBench("lookAhead",       benchLookAhead,   iSize, iAtomNo, 0, 0);
+      runBench("createBoard",     benchCreateBoard, iSize, iAtomNo, 0, 0);
+      runBench("createExitTable", benchExitTable,   iSize, iAtomNo, 0, 0);
+      runBench("moveAtom",        benchMoveAtom,    iSize, iAtomNo, 0, 0);
+    }
+  }
+
+  // Rendering doesn't depend on the atoms' density.
+  for (size_t s = 0; s < arraySize(g_aiSizes); ++s)
+    runBench("printBoard", benchPrintBoard, g_aiSizes[s], g_aiSizes[s] * g_aiSizes[s] / 20 + 1, 0, 1);
+
+  // The checksum is pointless, but must be used.
+  fprintf(stderr, "# checksum %lld\n", g_llSink);
+
+  free(g_paiCells);
+  free(g_paiDirs);
+  csFree(&g_tBench.csFilter);
+  csFree(&g_csMename);
+
+  return ERR_NOERR;
+}
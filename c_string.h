@@ -2,7 +2,7 @@
  ** Name: c_string.h
  ** Purpose:  Provides a self contained kind of string.
  ** Author: (JE) Jens Elstner
- ** Version: v0.21.6
+ ** Version: v0.26.0
  *******************************************************************************
  ** Date        User  Log
  **-----------------------------------------------------------------------------
@@ -81,6 +81,17 @@
  ** 23.07.2023  JE    Refactored csInStr() constants.
  ** 23.07.2023  JE    Now csInStrRev() start position is counted from left.
  ** 04.08.2023  JE    Now if sLenFrom == 0 csIconv() frees resources.
+ ** 16.10.2026  JE    Added csAppend() and csPushChar() to append in place.
+ ** 16.10.2026  JE    Now csCat() appends in place, if source is destination.
+ ** 16.10.2026  JE    Now csInput() and csReadLine() use csPushChar(), instead
+ **                   of two csNew() copies of the whole line per char.
+ ** 16.10.2026  JE    Now csReadLine() reads with getline() into the cstr.
+ ** 16.10.2026  JE    Added cstr_reader, csReaderNew(), csReaderFree() and
+ **                   csReadView() to read lines as views into a big buffer.
+ ** 16.10.2026  JE    Added csAppendf() to append like sprintf() in place.
+ ** 16.10.2026  JE    Added csReserve() and csExtend() to write right into the
+ **                   buffer.
+ ** 16.10.2026  JE    Added csReset() to empty a string keeping its buffer.
  *******************************************************************************/
 
 
@@ -106,6 +117,7 @@
 //* defines and macros
 
 #define C_STRING_INITIAL_CAPACITY 256
+#define C_STRING_READER_CAPACITY  65536
 
 // To give the cstr var a clean initialisation use
 // cstr str = csNew("");
@@ -133,6 +145,17 @@ typedef struct s_cstr {
   char*     cStr;     // array of chars we're storing
 } cstr;
 
+// Buffered line reader, hands out lines as views into its buffer.
+typedef struct s_cstr_reader {
+  FILE*     hFile;
+  char*     pcBuf;
+  long long capacity;  // size of buffer, one more for a trailing '\0'
+  long long start;     // offset of first char not read yet
+  long long end;       // offset after last char in buffer
+  int       bEof;      // file is read completely
+  int       bError;    // reading file failed
+} cstr_reader;
+
 
 //******************************************************************************
 //* function forward declarations
@@ -161,6 +184,12 @@ void csFree(cstr* pcsString);
 void        csSet(cstr* pcsString, const char* pcString);
 void        csSetf(cstr* pcsString, const char* pcFormat, ...);
 void        csCat(cstr* pcsDest, const char* pcSource, const char* pcAdd);
+void        csAppend(cstr* pcsDest, const char* pcAdd);
+void        csAppendf(cstr* pcsDest, const char* pcFormat, ...);
+void        csPushChar(cstr* pcsDest, char cChar);
+char*       csReserve(cstr* pcsDest, long long llAdd);
+void        csExtend(cstr* pcsDest, long long llLen);
+void        csReset(cstr* pcsDest);
 long long   csInStr(long long llPosStart, const char* pcString, const char* pcFind);
 long long   csInStrRev(long long llPosStart, const char* pcString, const char* pcFind);
 void        csMid(cstr* pcsDest, const char* pcSource, long long llOffset, long long llLength);
@@ -169,6 +198,9 @@ int         csSplitPos(long long llPos, cstr* pcsLeft, cstr* pcsRight, const cha
 void        csTrim(cstr* pcsOut, const char* pcString, int bWithNewLines);
 int         csInput(const char* pcMsg, cstr* pcsDest);
 int         csReadLine(cstr* pcsLine, FILE* hFile);
+cstr_reader csReaderNew(FILE* hFile);
+void        csReaderFree(cstr_reader* ptReader);
+int         csReadView(cstr_reader* ptReader, char** ppcLine, long long* pllLen);
 void        csSanitize(cstr* pcsLbl);
 int         csIconv(cstr* pcsFromStr, cstr* pcsToStr, const char* pcFrom, const char* pcTo, int iFactorGuess);
 int         csIsUtf8(const char* pcString);
@@ -406,23 +438,148 @@ void csSetf(cstr* pcsString, const char* pcFormat, ...) {
  * Purpose: Concatenates two strings to one cstr object.
  *******************************************************************************/
 void csCat(cstr* pcsDest, const char* pcSource, const char* pcAdd) {
-  cstr csOut = csNew(pcSource);
-  cstr csAdd = csNew(pcAdd);
+  cstr csOut = {0};
+
+  // Appending to itself needs no copy at all.
+  if (pcSource == pcsDest->cStr) {
+    csAppend(pcsDest, pcAdd);
+    return;
+  }
+
+  // Watch out, 'pcAdd' could be a pointer from 'pcsDest.cStr', too!
+  csOut = csNew(pcSource);
+  csAppend(&csOut, pcAdd);
+
+  csFree(pcsDest);
+  *pcsDest = csOut;
+}
+
+/*******************************************************************************
+ * Name: csAppend
+ * Purpose: Appends a string to cstr object in place. Capacity grows by
+ *          doubling, so appending n chars costs O(n) amortized.
+ *******************************************************************************/
+void csAppend(cstr* pcsDest, const char* pcAdd) {
+  long long llLen  = 0;
+  long long llUlen = cstr_len_utf8_char(pcAdd, &llLen);
+  long long llOff  = 0;
+
+  // A freed cstr has no buffer to append to.
+  if (pcsDest->cStr == NULL)
+    cstr_init(pcsDest);
+
+  // Watch out, 'pcAdd' could be a pointer into 'pcsDest.cStr', which moves
+  // on reallocation!
+  llOff = pcAdd - pcsDest->cStr;
+  cstr_double_capacity_if_full(pcsDest, llLen);
+  if (llOff >= 0 && llOff < pcsDest->size)
+    pcAdd = pcsDest->cStr + llOff;
+
+  // Append over '\0', memmove() because 'pcAdd' may overlap.
+  memmove(pcsDest->cStr + pcsDest->len, pcAdd, (size_t) llLen);
+
+  pcsDest->len               += llLen;
+  pcsDest->lenUtf8           += llUlen;
+  pcsDest->size              += llLen;
+  pcsDest->cStr[pcsDest->len] = '\0';
+}
+
+/*******************************************************************************
+ * Name: csAppendf
+ * Purpose: Appends to cstr object in place like sprintf().
+ *******************************************************************************/
+void csAppendf(cstr* pcsDest, const char* pcFormat, ...) {
+  va_list   args;
+  long long llLen  = 0;
+  long long llRoom = 0;
+
+  // A freed cstr has no buffer to append to.
+  if (pcsDest->cStr == NULL)
+    cstr_init(pcsDest);
+
+  // Try to print into the room left, including the old '\0'.
+  llRoom = pcsDest->capacity - pcsDest->size + 1;
+  va_start(args, pcFormat);
+  llLen = vsnprintf(pcsDest->cStr + pcsDest->len, (size_t) llRoom, pcFormat, args);
+  va_end(args);
+
+  // Too small, make room and print again.
+  if (llLen >= llRoom) {
+    cstr_double_capacity_if_full(pcsDest, llLen);
+    va_start(args, pcFormat);
+    vsnprintf(pcsDest->cStr + pcsDest->len, (size_t) (llLen + 1), pcFormat, args);
+    va_end(args);
+  }
+
+  pcsDest->lenUtf8 += cstr_len_utf8_char(pcsDest->cStr + pcsDest->len, &llLen);
+  pcsDest->len     += llLen;
+  pcsDest->size    += llLen;
+}
+
+/*******************************************************************************
+ * Name: csPushChar
+ * Purpose: Appends one char to cstr object in place, O(1) amortized.
+ *******************************************************************************/
+void csPushChar(cstr* pcsDest, char cChar) {
+  // A freed cstr has no buffer to append to.
+  if (pcsDest->cStr == NULL)
+    cstr_init(pcsDest);
+
+  cstr_double_capacity_if_full(pcsDest, 1);
+
+  // Only the first byte of an UTF-8 char counts.
+  if (!cstr_utf8_cont(cChar))
+    ++pcsDest->lenUtf8;
+
+  pcsDest->cStr[pcsDest->len++] = cChar;
+  pcsDest->cStr[pcsDest->len]   = '\0';
+  ++pcsDest->size;
+}
+
+/*******************************************************************************
+ * Name: csReserve
+ * Purpose: Makes room for llAdd more chars and returns where they go. Chars
+ *          written there count after csExtend().
+ *******************************************************************************/
+char* csReserve(cstr* pcsDest, long long llAdd) {
+  // A freed cstr has no buffer to append to.
+  if (pcsDest->cStr == NULL)
+    cstr_init(pcsDest);
 
-  // Make room for the second string.
-  cstr_double_capacity_if_full(&csOut, csAdd.size);
+  cstr_double_capacity_if_full(pcsDest, llAdd);
 
-  // Now append psAdd over csOut's '\0' including psAdd's '\0'.
-  for(long long i = 0; i < csAdd.size; ++i)
-    csOut.cStr[csOut.len + i] = pcAdd[i];
+  return pcsDest->cStr + pcsDest->len;
+}
 
-  csOut.len  = csOut.len  + csAdd.len;
-  csOut.size = csOut.size + csAdd.size - 1;
+/*******************************************************************************
+ * Name: csExtend
+ * Purpose: Counts llLen chars written after the end, see csReserve().
+ *******************************************************************************/
+void csExtend(cstr* pcsDest, long long llLen) {
+  const char* pcAdd = pcsDest->cStr + pcsDest->len;
 
-  csSet(pcsDest, csOut.cStr);
+  for (long long i = 0; i < llLen; ++i)
+    if (!cstr_utf8_cont(pcAdd[i]))
+      ++pcsDest->lenUtf8;
 
-  csFree(&csOut);
-  csFree(&csAdd);
+  pcsDest->len               += llLen;
+  pcsDest->size              += llLen;
+  pcsDest->cStr[pcsDest->len] = '\0';
+}
+
+/*******************************************************************************
+ * Name: csReset
+ * Purpose: Empties the string like csClear(), but keeps its buffer, so it can
+ *          be filled again without allocating.
+ *******************************************************************************/
+void csReset(cstr* pcsDest) {
+  pcsDest->len     = 0;
+  pcsDest->lenUtf8 = 0;
+  pcsDest->size    = 1;
+
+  // A freed cstr has no buffer to empty.
+  if (pcsDest->cStr != NULL)
+    pcsDest->cStr[0] = '\0';
 }
 
 /*******************************************************************************
@@ -596,8 +753,7 @@ void csTrim(cstr* pcsOut, const char* pcString, int bWithNewLines) {
  * Purpose: Kind of a getline() from stdin into a cstr object.
  *******************************************************************************/
 int csInput(const char* pcMsg, cstr* pcsDest) {
-  int  iChar     = 0;
-  char acChar[2] = {0};
+  int iChar = 0;
 
   // Print message and try to get input line.
   printf("%s", pcMsg);
@@ -616,9 +772,7 @@ int csInput(const char* pcMsg, cstr* pcsDest) {
     if ((char) iChar == '\n')
       return 1;
 
-    // Create a minute string of one char.
-    acChar[0] = (char) iChar;
-    csCat(pcsDest, pcsDest->cStr, acChar);
+    csPushChar(pcsDest, (char) iChar);
   }
 }
 
@@ -627,29 +781,124 @@ int csInput(const char* pcMsg, cstr* pcsDest) {
 //* Purpose: Reads a text line from file into a cstr object.
 //*******************************************************************************
 int csReadLine(cstr* pcsLine, FILE* hFile) {
-  int  iChar     = 0;
-  char acChar[2] = {0};
+  size_t    sCap   = 0;
+  long long llRead = 0;
+
+  // getline() reuses and grows the cstr's buffer itself.
+  if (pcsLine->cStr == NULL)
+    cstr_init(pcsLine);
+  sCap   = (size_t) pcsLine->capacity;
+  llRead = (long long) getline(&pcsLine->cStr, &sCap, hFile);
+  pcsLine->capacity = (long long) sCap;
+
+  if (llRead < 0) {
+    pcsLine->len     = 0;
+    pcsLine->lenUtf8 = 0;
+    pcsLine->size    = 1;
+    pcsLine->cStr[0] = '\0';
+    if (ferror(hFile)) {
+      clearerr(hFile);
+      return 0;
+    }
+    return 1;
+  }
+
+  // Cut off the '\n'.
+  if (llRead > 0 && pcsLine->cStr[llRead - 1] == '\n')
+    pcsLine->cStr[--llRead] = '\0';
+
+  pcsLine->lenUtf8 = cstr_len_utf8_char(pcsLine->cStr, &pcsLine->len);
+  pcsLine->size    = pcsLine->len + 1;
+
+  return 1;
+}
+
+/*******************************************************************************
+ * Name:  csReaderNew
+ * Purpose: Creates a buffered line reader of an open file.
+ *******************************************************************************/
+cstr_reader csReaderNew(FILE* hFile) {
+  cstr_reader tReader = {0};
+
+  tReader.hFile    = hFile;
+  tReader.capacity = C_STRING_READER_CAPACITY;
+  tReader.pcBuf    = (char*) malloc(sizeof(char) * (tReader.capacity + 1));
+
+  return tReader;
+}
+
+/*******************************************************************************
+ * Name:  csReaderFree
+ * Purpose: Frees reader's buffer, the file stays open.
+ *******************************************************************************/
+void csReaderFree(cstr_reader* ptReader) {
+  free(ptReader->pcBuf);
+  ptReader->pcBuf    = NULL;
+  ptReader->capacity = 0;
+  ptReader->start    = 0;
+  ptReader->end      = 0;
+}
 
-  csSet(pcsLine, "");
+/*******************************************************************************
+ * Name:  csReadView
+ * Purpose: Reads next line as a view into reader's buffer, without '\n' or
+ *          '\r\n' and terminated by '\0'. The view holds till the next call.
+ *          Returns 0 at end of file or on error, see 'bError'.
+ *******************************************************************************/
+int csReadView(cstr_reader* ptReader, char** ppcLine, long long* pllLen) {
+  char*     pcNl   = NULL;
+  long long llCut  = 0;
+  long long llRead = 0;
 
   while (1) {
-    iChar = fgetc(hFile);
+    // Whole line in buffer already?
+    pcNl = (char*) memchr(ptReader->pcBuf + ptReader->start, '\n',
+                          (size_t) (ptReader->end - ptReader->start));
+    if (pcNl != NULL) {
+      llCut = pcNl - ptReader->pcBuf;
+      break;
+    }
 
-    if (ferror(hFile)) {
-      clearerr(hFile);
-      return 0;
+    // Last line without '\n'.
+    if (ptReader->bEof) {
+      if (ptReader->start == ptReader->end)
+        return 0;
+      llCut = ptReader->end;
+      break;
     }
-    if (iChar == '\n')
-      return 1;
-    if (iChar ==  EOF)
-      return 1;
 
-    // Create a minute string of one char.
-    acChar[0] = (char) iChar;
-    csCat(pcsLine, pcsLine->cStr, acChar);
+    // Move the rest of the line to the front and fill up behind it. A line
+    // longer than the buffer doubles it.
+    memmove(ptReader->pcBuf, ptReader->pcBuf + ptReader->start,
+            (size_t) (ptReader->end - ptReader->start));
+    ptReader->end  -= ptReader->start;
+    ptReader->start = 0;
+    if (ptReader->end == ptReader->capacity) {
+      ptReader->capacity *= 2;
+      ptReader->pcBuf     = (char*) realloc(ptReader->pcBuf, sizeof(char) * (ptReader->capacity + 1));
+    }
+
+    llRead = (long long) fread(ptReader->pcBuf + ptReader->end, sizeof(char),
+                               (size_t) (ptReader->capacity - ptReader->end), ptReader->hFile);
+    ptReader->end += llRead;
+    if (llRead == 0) {
+      ptReader->bEof   = 1;
+      ptReader->bError = ferror(ptReader->hFile) != 0;
+      if (ptReader->bError)
+        return 0;
+    }
   }
 
-  return 0;
+  *ppcLine = ptReader->pcBuf + ptReader->start;
+  *pllLen  = llCut - ptReader->start;
+  ptReader->start = (llCut < ptReader->end) ? llCut + 1 : llCut;
+
+  // Cut off '\r' of DOS line ends, too.
+  if (*pllLen > 0 && (*ppcLine)[*pllLen - 1] == '\r')
+    --(*pllLen);
+  (*ppcLine)[*pllLen] = '\0';
+
+  return 1;
 }
 
 //*******************************************************************************
@@ -16,6 +16,69 @@
  ** 20.04.2021  JE    Now use 'c_dynamic_arrays_macros.h'.
  ** 24.09.2023  JE    Refactored the git from single archive file.
  ** 24.09.2023  JE    Now uses latest libs and deleted unused.
+ ** 16.10.2026  JE    Added exit table, so each beam is just a lookup.
+ ** 16.10.2026  JE    Added '--batch' to replay probe scripts without prompts.
+ ** 16.10.2026  JE    Added '--bitboard' to walk beams on atom bitmasks.
+ ** 16.10.2026  JE    Now all board functions work on a given board 't_board'.
+ ** 16.10.2026  JE    Added '--simulate' and '--threads' for beam statistics.
+ ** 16.10.2026  JE    Now '-a' and '-s' use getArgInt() to not overwrite options.
+ ** 16.10.2026  JE    Added '--seed' and now atoms are picked by Fisher-Yates
+ **                   with xoshiro256** from 'stdfcns.c' v0.11.0.
+ ** 16.10.2026  JE    Added solver, 's' shows what the beams so far imply.
+ ** 16.10.2026  JE    Fixed look ahead off the grid after turning at border.
+ ** 16.10.2026  JE    Added advisor, 'a' rates beams by expected information.
+ ** 16.10.2026  JE    Now '--batch' reads lines as views with 'c_string.h'
+ **                   v0.23.0 and accepts DOS line ends.
+ ** 16.10.2026  JE    Added '--serve' to host many games in one process.
+ ** 16.10.2026  JE    Now renderBoard() and renderScore() write into a cstr.
+ ** 16.10.2026  JE    Now '--serve' spreads sessions over shards, one per
+ **                   thread, and '--load' drives them in process.
+ ** 16.10.2026  JE    Added '--record' and '--replay' for binary game records.
+ ** 16.10.2026  JE    Added '--index' and '--find' to look up games on a board,
+ **                   boards equal but for rotations and mirrors are one.
+ ** 16.10.2026  JE    Added '--symmetry', '--simulate' counts each board in all
+ **                   its rotations and mirrors.
+ ** 16.10.2026  JE    Added '--enumerate' to fire all beams into every board.
+ ** 16.10.2026  JE    Added beam cache, '--enumerate' walks just the beams next
+ **                   to an atom moved.
+ ** 16.10.2026  JE    Added walkBeams(), createExitTable() walks the beams of
+ **                   large boards in lockstep with AVX2.
+ ** 16.10.2026  JE    Now lookAhead(), turnBeam() and goAhead() use tables of
+ **                   steps and turns instead of branches.
+ ** 16.10.2026  JE    Added '--sparse' to simulate huge boards, keeping just
+ **                   their atoms.
+ ** 16.10.2026  JE    Now renderBoard() writes right into the buffer reserved
+ **                   with 'c_string.h' v0.25.0, printBoard() with one write.
+ ** 16.10.2026  JE    Added '--tui' to draw the board once and then just mark
+ **                   each beam's edges with ANSI cursor escapes.
+ ** 16.10.2026  JE    Added t_marks, the outcome of each edge kept as beams
+ **                   arrive, renderBoard() draws them around the board.
+ ** 16.10.2026  JE    Added '--format json|csv' to write each game event to
+ **                   stdout, all the prose goes to stderr then.
+ ** 16.10.2026  JE    Added '--rules' to score by other weights, beams of an
+ **                   edge once or atoms found once, '--replay' streams the
+ **                   score distribution of each set of rules in one pass.
+ ** 16.10.2026  JE    Fixed walkBeams() gathering off the grid once a beam
+ **                   reached the top or bottom border, AVX2 on x86 only.
+ ** 16.10.2026  JE    Now the solver's candidates walk their beams on the
+ **                   bitmasks with '--bitboard'.
+ ** 16.10.2026  JE    Fixed solver's counts overflowing on large boards, now
+ **                   binomial() and the counts saturate.
+ ** 16.10.2026  JE    Now the solver stops after SOLVER_MAX_NODES cells and
+ **                   tells its count is a lower bound, walks needing more
+ **                   atoms than left are cut early.
+ ** 16.10.2026  JE    Now '--enumerate --symmetry' walks just canonical boards
+ **                   and maps their rows to all images, '--simulate' lost
+ **                   '--symmetry'. The solver takes each probe once and maps
+ **                   its solutions for probes equal but for symmetry.
+ ** 16.10.2026  JE    Fixed '--enumerate' computing the count of boards before
+ **                   checking the board's size.
+ ** 16.10.2026  JE    Added walkGrids(), the solver checks new probes and the
+ **                   advisor rates beams on batches of candidates at once.
+ ** 16.10.2026  JE    Fixed grid boards too large for an int crashing, sizes
+ **                   above GRID_MAX_SIZE need '--simulate --sparse' now.
+ ** 16.10.2026  JE    Now '--enumerate' prints the probes needed to tell all
+ **                   boards apart, by beams picked greedily from the table.
  *******************************************************************************/
 
 
@@ -25,7 +88,27 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <math.h>
 #include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <poll.h>
+#include <netinet/in.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 #include "c_string.h"
 #include "c_dynamic_arrays_macros.h"
@@ -34,7 +117,7 @@
 //******************************************************************************
 //* defines & macros
 
-#define ME_VERSION "0.6.3"
+#define ME_VERSION "0.24.1"
 cstr g_csMename;
 
 #define ERR_NOERR 0x00
@@ -64,12 +147,107 @@ cstr g_csMename;
 #define ATOM_CENTER 0x01
 #define ATOM_LEFT   0x02
 #define ATOM_RIGHT  0x03
+#define ATOM_OPEN   0x04  // Solver hasn't decided on a looked up cell yet.
+
+#define WALK_OPEN (-1)    // Beam ran into a cell the solver hasn't decided yet.
+
+// Bitboard
+#define BITS_WORD 64
+
+// Beams walked in lockstep by walkBeams(), two AVX2 vectors of 8.
+#define LANES          16
+#define LANES_MIN_SIZE 32  // Smaller boards' beams are too short to pay off.
+#define GRIDS_BATCH     64       // Boards walked at once by walkGrids().
+#define GRIDS_MAX_CELLS 0x40000  // Max cells of all their grids.
+
+// Solver
+#define SOLVER_MAX_KEPT  1000000  // Max candidates kept to re-solve on them.
+#define SOLVER_MAX_NODES 2000000  // Max cells decided per search, about a second.
+
+// Advisor
+#define ADVISOR_MAX_RATED 20000  // Max candidates to rate the next beam on.
+#define ADVISOR_MAX_TRIES 1000   // Random boards per candidate, if none kept.
+#define ADVISOR_BEST      5      // Count of beams advised.
 
 #define SCORE_ATOM      -5
 #define SCORE_EXIT      -3
 #define SCORE_REFLECTED -2
 #define SCORE_ABSORBED  -1
 
+// Rules to score by, given with '--rules'.
+#define RULES_MAX      16  // Most sets of rules at once.
+#define RULES_MAX_NAME 64
+#define STATS_BINS     64  // First bins of a score histogram, it grows as needed.
+
+// Batch result records.
+#define RES_ABSORBED  "A"
+#define RES_REFLECTED "R"
+#define RES_INVALID   "?"
+
+// Server
+#define SERVE_EVENTS   256   // Max events per epoll_wait().
+#define SERVE_BACKLOG  1024  // Max connections waiting to be accepted.
+#define SERVE_MAX_LINE 4096  // Max length of a session's input line.
+#define SERVE_READ     4096  // Bytes read per read().
+#define SERVE_QUEUE    4096  // Requests per queue, a power of two.
+
+// Shard requests, besides a connection's file descriptor.
+#define REQ_PROBE (-1)  // Fire a beam in a load session.
+#define REQ_STOP  (-2)  // All requests done, stop the shard.
+
+// Game records, "BBR1" read little endian. Records are in host byte order,
+// so on hosts of other byte order the magic reads swapped.
+#define REC_MAGIC    0x31524242
+#define REC_FOREIGN  (-2)   // Record of a host of other byte order.
+#define GRID_MAX_SIZE 46338  // Largest grid board, so its (size + 2)^2 cells fit into an int.
+#define REC_MAX_SIZE 16383  // Largest board, so each edge fits into 16 bits.
+#define IDX_MAGIC    0x31494242  // "BBI1" read little endian.
+#define IDX_SUFFIX   ".idx"      // Index file is the record file plus suffix.
+
+// Symmetries of the square board, identity, 3 rotations and 4 mirrors.
+#define SYM_COUNT 8
+
+// Table of all boards' beams.
+#define ENUM_MAGIC      0x31454242  // "BBE1" read little endian.
+#define ENUM_MAX_SIZE   63          // Largest board, so each exit fits into a byte.
+#define ENUM_MAX_BOARDS 200000000   // Most boards enumerated at once.
+
+// Marks of the beams' outcomes around the board.
+#define MARK_NONE      0
+#define MARK_ABSORBED  (-1)
+#define MARK_REFLECTED (-2)
+#define MARK_MARGIN    "    "  // Left of each line for the left edge's marks.
+
+// Terminal UI, rows and columns count from 1 like ANSI cursor escapes do.
+#define TUI_MARGIN    ((int) sizeof(MARK_MARGIN) - 1)
+#define TUI_ROW_CELLS 5  // Row of the board's first cells.
+
+// Game events of '--format', fields in this order.
+#define FORMAT_TEXT  0
+#define FORMAT_JSON  1
+#define FORMAT_CSV   2
+#define EV_SEED      0
+#define EV_SIZE      1
+#define EV_ATOMS     2
+#define EV_ENTRY     3
+#define EV_EXIT      4
+#define EV_OUTCOME   5
+#define EV_Y         6
+#define EV_X         7
+#define EV_HIT       8
+#define EV_MISSED    9
+#define EV_EXITED    10
+#define EV_REFLECTED 11
+#define EV_ABSORBED  12
+#define EV_TOTAL     13
+#define EV_COUNT     14
+#define EV_MAX_LEN   1024   // Longest event with all its fields.
+#define EV_FLUSH     65536  // Bytes of events buffered before they're written.
+
+// Load generator
+#define LOAD_SESSIONS 10000  // Count of sessions the probes are spread over.
+#define LOAD_BATCH    256    // Requests pushed before the shard is woken up.
+
 
 //******************************************************************************
 //* outsourced standard functions, includes and defines
@@ -80,13 +258,46 @@ cstr g_csMename;
 //******************************************************************************
 //* typedefs
 
+// Rules to score a game by, points per item are negative.
+typedef struct s_rules {
+  char acName[RULES_MAX_NAME];
+  int  iAtom;       // Points per atom missed.
+  int  iExit;       // Points per beam exited.
+  int  iReflected;
+  int  iAbsorbed;
+  int  bDedup;      // Beams from an edge scored already score nothing.
+  int  bAtomsOnce;  // Atoms not found are missed, guessing one twice won't do.
+} t_rules;
+
 // Arguments and options.
 typedef struct s_options {
-  int iAtomNo;
-  int iWidth;
-  int iSize;
-  int iCellNo;
-  int bPrtBrd;
+  int  iAtomNo;
+  int  iSize;
+  int  bPrtBrd;
+  int  bTui;
+  int  iFormat;   // FORMAT_TEXT, else game events as JSON or CSV.
+  int  bBatch;
+  int  bReplay;
+  int  bIndex;
+  int  bFind;
+  int  bEnumerate;
+  int  bBitboard;
+  int  bSymmetry;
+  int  bSparse;
+  int  bServe;
+  int  iThreads;
+  ll   llSimulate;
+  ll   llLoad;
+  ll   llSeed;
+  cstr csBatch;
+  cstr csServe;   // TCP port or Unix socket path to serve games on.
+  cstr csRecord;  // File to append game records to.
+  cstr csReplay;  // File of game records to replay.
+  cstr csIndex;   // File of game records to index.
+  cstr csFind;    // File of game records to find the board of '--seed' in.
+  cstr csEnumerate; // File to write the beams of all boards to.
+  int  iRules;
+  t_rules atRules[RULES_MAX];  // The game is scored by the first ones.
 } t_options;
 
 // Arguments and options.
@@ -97,8 +308,315 @@ typedef struct s_score {
   int  iExited;
 } t_score;
 
+// Score of one game by a set of rules, fed beam by beam and guess by guess.
+typedef struct s_scorer {
+  const t_rules* ptRules;
+  int       iSize;
+  int       iFound;     // Atoms found, each just once.
+  uint32_t  uiGame;     // Stamp of the game, so no array needs clearing.
+  uint32_t* pauiEdges;  // Stamp per edge scored in the game, if 'bDedup'.
+  uint32_t* pauiCells;  // Stamp per inner cell found, if 'bAtomsOnce'.
+  t_score   tScore;
+} t_scorer;
+
+// Distribution of scores, streamed game by game without keeping them.
+typedef struct s_score_stats {
+  ll     llGames;
+  ll     llMin;
+  ll     llMax;
+  double dMean;     // Running mean and sum of squared deviations (Welford).
+  double dM2;
+  ll     llLow;     // Score counted in the first bin.
+  ll     llBins;
+  ll*    pallHist;  // Games per score from 'llLow' on.
+} t_scoreStats;
+
+// Outcome of each edge of the beams fired, computed as beams arrive.
+typedef struct s_marks {
+  int  iSize;
+  int  iPairs;     // Count of exit pairs, labeled from 1 on.
+  int* paiMarks;   // Per edge from 1, MARK_NONE, MARK_ABSORBED, MARK_REFLECTED
+                   // or the label shared by both edges of a pair.
+} t_marks;
+
+// Board with its atoms and beams, each board is independent of all others.
+typedef struct s_board {
+  int       iSize;
+  int       iAtomNo;
+  int       iWidth;     // Size plus two border cells.
+  int       iCellNo;
+  int       bBitboard;  // Walk beams with bitmasks instead of the grid.
+  int       iWords;     // Count of 64 bit words per bitboard line.
+  int       iAtomsSet;  // Count of atoms actually set.
+  int*      paiGrid;
+  int*      paiExits;   // Exit node per entry node, 0 if absorbed.
+  int*      paiAtoms;   // Cells of atoms set.
+  int*      paiFree;    // All inner cells, shuffled to pick atoms.
+  int*      paiPicks;   // Swaps of the shuffle, to undo them.
+  uint64_t* paullRows;  // Atoms per row, bit x set for cell (x, y).
+  uint64_t* paullCols;  // Atoms per column, bit y set for cell (x, y).
+  int*      paiEntries; // Entry cell per beam, for walkBeams().
+  int*      paiDirs;    // Entry direction per beam, for walkBeams().
+  int*      paiOuts;    // Exit cell per beam, from walkBeams().
+  int       aiAhead[8] __attribute__((aligned(32)));  // Cell offset one step ahead per direction.
+  int       aiSide[8]  __attribute__((aligned(32)));  // Cell offset to the left per direction.
+} t_board;
+
+// Simulation's share of one thread.
+typedef struct s_simulation {
+  pthread_t tThread;
+  ll        llBoards;
+  t_rand    tRand;      // Thread's own random state.
+  ll*       pallHist;   // Count per entry and exit node, exit 0 if absorbed.
+                        // Sparse boards just count absorbed and reflected.
+} t_simulation;
+
+// A fired beam and where it came out, 0 if absorbed, iEntry if reflected.
+typedef struct s_probe {
+  int iEntry;
+  int iExit;
+} t_probe;
+
+// Head of a binary game record, all numbers in host byte order. The head is
+// followed by the atoms as bitmask, bit y * size + x for the inner cell (x, y)
+// counted from 0 and padded to 4 bytes, then entry and exit node of each probe
+// as two uint16_t, then the inner cell of each guess as uint32_t. The whole
+// record is padded to 8 bytes, so the next head is aligned, too.
+typedef struct s_record {
+  uint32_t uiMagic;
+  uint32_t uiBytes;        // Size of the whole record.
+  uint64_t ullSeed;        // Seed the board was created with.
+  uint32_t uiSize;
+  uint32_t uiAtomNo;
+  uint32_t uiProbes;
+  uint32_t uiGuesses;
+  uint32_t uiMissedAtoms;  // Score as in 't_score'.
+  uint32_t uiAbsorbed;
+  uint32_t uiReflected;
+  uint32_t uiExited;
+} t_record;
+
+// View of one record, straight into the mapped file.
+typedef struct s_record_view {
+  const t_record* ptHead;
+  const uint8_t*  paucAtoms;
+  const uint16_t* pausProbes;   // Entry and exit node of each probe.
+  const uint32_t* pauiGuesses;
+} t_recordView;
+
+// Head of a record file's index, followed by its entries.
+typedef struct s_index_head {
+  uint32_t uiMagic;
+  uint32_t uiReserved;
+  uint64_t ullEntries;
+  uint64_t ullFileSize;    // Size of the record file indexed, to detect changes.
+} t_indexHead;
+
+// Entry of a record file's index, sorted by size, atoms, hash and offset.
+typedef struct s_index {
+  uint64_t ullHash;        // Hash of the canonical atoms, see hashAtoms().
+  uint32_t uiSize;
+  uint32_t uiAtomNo;
+  uint64_t ullOffset;      // Offset of the record in the record file.
+} t_index;
+
 // Create dynamic array struct.
 s_array(cstr);
+s_array(int);
+s_array(t_probe);
+
+// Exits of all beams kept up to date while single atoms change. Each beam's
+// walk depends on the cells around the cells it stood on, so an atom changing
+// just stales the beams which stood next to it.
+typedef struct s_beam_cache {
+  int           iBeams;     // Count of beams, 4 * size.
+  int           iWords;     // 64 bit words per set of beams.
+  uint64_t*     paullOn;    // Beams which stood on each cell, iWords per cell.
+  uint64_t*     paullStale; // Beams to walk again.
+  t_array(int)* patPaths;   // Cells each beam stood on, per beam from 1 on.
+} t_beamCache;
+
+// Head of a table of all boards, followed by each board's exit per beam.
+typedef struct s_enum_head {
+  uint32_t uiMagic;
+  uint32_t uiSize;
+  uint32_t uiAtomNo;
+  uint32_t uiBeams;        // Bytes per board, one per beam.
+  uint64_t ullBoards;
+} t_enumHead;
+
+// Hash of a board's exits, to find boards no beams tell apart. With
+// '--symmetry' it stands for all images of a canonical board, its row is the
+// least of their rows.
+typedef struct s_enum_key {
+  uint64_t ullHash;
+  uint64_t ullRank;        // Board's rank, its row in the table.
+  uint32_t uiBoards;       // Count of distinct images of the board.
+  uint32_t uiRows;         // Count of distinct rows of these images.
+} t_enumKey;
+
+s_array(t_enumKey);
+
+// Probe picking's share of one thread, whole groups of rows.
+typedef struct s_prober {
+  pthread_t      tThread;
+  const uint8_t* paucRows;   // Rows of the exits of the beams not picked yet.
+  const size_t*  pasStarts;  // First row of each group, and one past the last.
+  size_t         sFrom;      // First group.
+  size_t         sTo;        // Group past the last.
+  int            iWidth;     // Bytes per row, beams not picked yet.
+  uint32_t*      pauiSeen;   // Group last seen per beam and exit.
+  size_t*        pasGroups;  // Groups the rows split into per beam.
+} t_prober;
+
+// Enumeration's share of one thread.
+typedef struct s_enumerator {
+  pthread_t   tThread;
+  t_board     tBoard;
+  t_beamCache tCache;      // Beams to walk again after atoms moved.
+  atomic_int* piNextTop;   // Next highest atom cell to take, shared.
+  int*        paiComb;     // Inner cells of atoms, ascending.
+  int*        paiPrev;     // Inner cells of atoms of the board before.
+  char*       pacIn;       // Inner cell is in paiComb.
+  ll*         pallBinom;   // Table of c choose i, iAtomNo + 1 per cell.
+  uint8_t*    paucTable;   // Mapped table's rows.
+  int*        paiSymEdges; // Node under each symmetry, NULL to walk all boards.
+  int*        paiSymCells; // Inner cell under each symmetry.
+  int*        paiImage;    // Inner cells of an image's atoms, ascending.
+  uint8_t*    paucRows;    // Row of each image, SYM_COUNT of them.
+  ll          allRanks[SYM_COUNT];  // Rank of each image.
+  t_array(t_enumKey) tKeys;  // Hash per board walked.
+  ll          llBoards;
+  ll          llWalked;    // Boards walked, just the canonical with symmetry.
+} t_enumerator;
+
+// Board keeping just its atoms, for huge sizes. Cells are (x, y) like on the
+// grid, with the border at 0 and size + 1.
+typedef struct s_sparse {
+  int       iSize;
+  int       iAtomNo;
+  int       iAtomsSet;
+  uint64_t* paullRows;  // Atoms as y << 32 | x, sorted.
+  uint64_t* paullCols;  // Atoms as x << 32 | y, sorted.
+} t_sparse;
+
+// Candidate boards consistent with all probes so far.
+typedef struct s_solver {
+  t_board      tBoard;      // Candidate board to walk the beams on.
+  int          iProbes;     // Count of probes the candidates are checked with.
+  t_array(t_probe) tProbes; // Distinct probes, the ones checked before first.
+  t_probe*     patKey;      // Canonical probes of the last search.
+  int          iKey;        // Count of them, -1 before any search.
+  int          iSym;        // Symmetry mapping the probes to their key.
+  ll           llSolutions;
+  ll*          pallAtoms;   // Count of solutions per cell holding an atom.
+  int          bKept;       // All candidates are kept in tCands.
+  t_array(int) tCands;      // Atom cells of each candidate, iAtomNo per board.
+  int*         paiCell;     // Entry cell per probe.
+  int*         paiDir;      // Entry direction per probe.
+  int*         paiDone;     // Depth where probe's walk got decided, else -1.
+  char*        pacDecided;  // Cell is decided to be an atom or not.
+  ll           llNodes;     // Cells decided in this search.
+  int          bExhaustive; // Search went through, else counts are a lower bound.
+  uint32_t     uiStamp;     // Last stamp of the cells below, so none needs clearing.
+  uint32_t*    pauiSeen;    // Stamp per cell seen by a walk.
+  uint32_t*    pauiClaimed; // Stamp per cell claimed by a walk needing an atom.
+  int*         paiSeen;     // Cells not decided a walk has seen.
+} t_solver;
+
+// Advisor's share of one thread.
+typedef struct s_advisor {
+  pthread_t tThread;
+  t_solver* ptSol;      // Solver with all probes' entry cells and directions.
+  t_probe*  patProbes;
+  int       iProbes;
+  int*      paiCands;   // Candidates to rate, if NULL random boards are drawn.
+  size_t    sCands;     // Count of candidates to rate.
+  size_t    sRated;     // Count of candidates rated.
+  ll        llTries;    // Max random boards to draw.
+  t_rand    tRand;      // Thread's own random state.
+  ll*       pallHist;   // Count per entry and exit node, exit 0 if absorbed.
+} t_advisor;
+
+// One player's game on the server, all its state is here.
+typedef struct s_session {
+  int     iFd;
+  t_board tBoard;
+  t_scorer tScorer;
+  int     iAnswered;  // Count of atoms answered, -1 while beams are fired.
+  int     bClose;     // Close session as soon as all output is sent.
+  int     bWaitOut;   // Waiting for the socket to take more output.
+  cstr    csIn;       // Input received, but no complete line yet.
+  cstr    csOut;      // Output not sent yet.
+  ll      llSent;     // Bytes of csOut sent already.
+  ll      llSeed;     // Seed of the board, to record it.
+  int*    paiGuesses; // Guessed cells, to record them.
+  t_array(t_probe) tProbes;  // All beams fired, to record them.
+} t_session;
+
+// Terminal UI, the board is drawn once, then just the edges' marks change.
+typedef struct s_tui {
+  int  iSize;
+  int  iStatusRow;  // Row of the last beam's outcome, the prompt goes below.
+  int  bDirty;      // Output might have scrolled the board, draw it again.
+  cstr csBoard;     // Board rendered, to be drawn line by line.
+  cstr csOut;       // Escapes and marks not written yet.
+} t_tui;
+
+// Game events, buffered and written to stdout at once.
+typedef struct s_events {
+  int   iFormat;
+  int   iFd;    // The real stdout, prose goes to stderr.
+  int   iCol;   // Next CSV field of the event.
+  int   bSync;  // Input might wait for the events, else it's a file.
+  char* pcOut;  // Next char of the event in csOut's room.
+  cstr  csOut;  // Events not written yet.
+} t_events;
+
+// Request handed over to a shard.
+typedef struct s_request {
+  int iFd;       // Connection to take over, else REQ_PROBE or REQ_STOP.
+  int iSession;  // Load session to fire the beam in.
+  int iEntry;
+} t_request;
+
+// Lock free queue between exactly one producer and one consumer thread.
+typedef struct s_queue {
+  t_request*                 patRing;
+  _Alignas(64) atomic_size_t sHead;  // Next to pop, written by consumer only.
+  _Alignas(64) atomic_size_t sTail;  // Next to push, written by producer only.
+} t_queue;
+
+// Probes a shard took, counted in locals and stored at stop, as the shards'
+// structs lie next to each other.
+typedef struct s_probe_counts {
+  ll llProbes;
+  ll llAbsorbed;
+  ll llReflected;
+} t_probeCounts;
+
+// Shard of the server, a thread owning its sessions, nothing is shared.
+typedef struct s_shard {
+  pthread_t     tThread;
+  int           iEpoll;
+  int           iWake;      // eventfd waking the shard up on new requests.
+  int           iQueues;
+  t_queue*      patQueues;  // One queue per producer.
+  t_rand        tRand;      // Shard's own random state for new boards.
+  int           iSessions;  // Count of load sessions.
+  t_board*      patBoards;  // Load sessions' boards.
+  t_probeCounts tCounts;    // Set once the shard stopped.
+} t_shard;
+
+// Load generator's share of one thread.
+typedef struct s_loader {
+  pthread_t tThread;
+  int       iQueue;       // Producer's queue at each shard.
+  ll        llProbes;
+  t_rand    tRand;        // Drawn from a local copy while running.
+  int       iShards;
+  t_shard*  patShards;
+} t_loader;
 
 
 //******************************************************************************
@@ -107,8 +625,51 @@ s_array(cstr);
 // Arguments
 t_options     g_tOpts;    // CLI options and arguments.
 t_array(cstr) g_tArgs;    // Free arguments.
-t_score       g_tScore;
-int*          g_paiGrid;
+t_scorer      g_tScorer;  // Score of the game played.
+t_board       g_tBoard;   // The board of the game played.
+
+t_array(t_probe) g_tProbes; // All beams fired in this game.
+FILE*            g_hRecord;  // Game records are appended here, if any.
+t_solver         g_tSolver;
+t_marks          g_tMarks;   // Outcome of each edge of this game.
+t_tui            g_tTui;     // Terminal UI of '--tui'.
+t_events         g_tEvents;  // Game events of '--format'.
+const uint8_t*   g_paucEnumRows;  // Table's rows, for compareEnumKey().
+int              g_iEnumBeams;    // Bytes per row of the table.
+
+// Rules by name for '--rules', the first are the default ones. Classic is the
+// original game's: each edge marked costs a point, so an exit costs two.
+static const t_rules g_atPresets[] = {
+  {"default", SCORE_ATOM, SCORE_EXIT, SCORE_REFLECTED, SCORE_ABSORBED, 0, 0},
+  {"classic", -5,         -2,         -1,              -1,             1, 1}
+};
+
+// Names of the events' fields, in the order of EV_*.
+static const char* g_apcEvCols[EV_COUNT] = {
+  "seed", "size", "atoms", "entry", "exit", "outcome", "y", "x", "hit",
+  "missed", "exited", "reflected", "absorbed", "total"
+};
+
+// What lookAhead() sees per atoms ahead (bit 2), ahead left (bit 1) and ahead
+// right (bit 0), the first found wins.
+static const int g_aiSeen[8] = {
+  ATOM_NONE, ATOM_RIGHT, ATOM_LEFT, ATOM_LEFT,
+  ATOM_CENTER, ATOM_CENTER, ATOM_CENTER, ATOM_CENTER
+};
+
+// Steps in x and y per direction.
+static const int g_aiStepX[5] = {0,  0, -1, 0, 1};
+static const int g_aiStepY[5] = {0, -1,  0, 1, 0};
+
+// Direction per atom seen and direction, an atom ahead left turns the beam
+// right and one ahead right turns it left. Rows are 8 wide for AVX2.
+static const int g_aaiTurned[5][8] __attribute__((aligned(32))) = {
+  [ATOM_NONE]   = {0, DIR_UP,    DIR_LEFT, DIR_DOWN,  DIR_RIGHT},
+  [ATOM_CENTER] = {0, DIR_UP,    DIR_LEFT, DIR_DOWN,  DIR_RIGHT},
+  [ATOM_LEFT]   = {0, DIR_RIGHT, DIR_UP,   DIR_LEFT,  DIR_DOWN},
+  [ATOM_RIGHT]  = {0, DIR_LEFT,  DIR_DOWN, DIR_RIGHT, DIR_UP},
+  [ATOM_OPEN]   = {0, DIR_UP,    DIR_LEFT, DIR_DOWN,  DIR_RIGHT}
+};
 
 
 //******************************************************************************
@@ -127,7 +688,19 @@ void usage(int iErr, char* pcMsg) {
 
   csSetf(&csMsg, "%s"
 //|************************ 80 chars width ****************************************|
-  "usage: %s [-a n] [-s n] [-b]\n"
+  "usage: %s [-a n] [-s n] [-b|--tui] [--bitboard] [--seed n] [--record file]\n"
+  "          [--format json|csv] [--rules r]\n"
+  "       %s [--bitboard] --batch file\n"
+  "       %s [-a n] [-s n] [--bitboard] [--seed n] --simulate n [--threads n]\n"
+  "          [--sparse]\n"
+  "       %s [-a n] [-s n] [--bitboard] --enumerate file [--threads n]\n"
+  "          [--symmetry]\n"
+  "       %s [-a n] [-s n] [--bitboard] [--seed n] --serve port|path\n"
+  "          [--threads n] [--record file] [--rules r]\n"
+  "       %s --replay file [--rules r ...]\n"
+  "       %s --index file\n"
+  "       %s [-a n] [-s n] --seed n --find file [--rules r]\n"
+  "       %s [-a n] [-s n] [--bitboard] [--seed n] --load n [--threads n]\n"
   "       %s [-h|--help|-v|--version]\n"
   " This program plays a decent game of BlackBox.\n"
   " Per default it contents of a 8 x 8 grid with 4 hidden atoms.\n"
@@ -171,16 +744,76 @@ void usage(int iErr, char* pcMsg) {
   " If you enter 'e' at the prompt the program  will ask you for the\n"
   " coordinates of each atom hidden and then print the score according to your\n"
   " input. If you enter 'q' at the prompt the programm just quit.\n"
-  " If you enter 'b' at the prompt the empty board will be redrawn.\n"
+  " If you enter 'b' at the prompt the empty board will be redrawn, with the\n"
+  " outcome of the beams next to their edges: 'A' absorbed, 'R' reflected and\n"
+  " the same letters at both edges of a beam exited.\n"
+  " If you enter 's' at the prompt the solver shows how many boards fit to\n"
+  " all beams so far and which cells must or can't hold an atom.\n"
+  " If you enter 'a' at the prompt the advisor lists the beams, whose outcome\n"
+  " tells most about the atoms, with the expected information in bits.\n"
   " \n"
   "  -a n:          count of atoms hidden (default 4)\n"
-  "  -s n:          size of blackbox grid n x n (default 8)\n"
+  "  -s n:          size of blackbox grid n x n (default 8), at most 46338\n"
+  "                 but with '--simulate --sparse'\n"
   "  -b:            print board after each attempt\n"
+  "  --tui:         draw the board once, skipping the intro, and just mark the\n"
+  "                 edges of each beam with cursor escapes. Falls back to\n"
+  "                 plain output if the board doesn't fit into the terminal\n"
+  "  --format fmt:  write each event of the game to stdout as a JSON object or\n"
+  "                 CSV row per line, the board, each probe with entry, exit\n"
+  "                 (0 if absorbed) and outcome, each guess and the score. The\n"
+  "                 game's text goes to stderr then\n"
+  "  --bitboard:    walk beams on bitmasks of atoms instead of the grid\n"
+  "  --seed n:      seed for a reproducible board (default current time)\n"
+  "  --record file: append a binary record of each finished game to file, with\n"
+  "                 board, beams, guesses and score\n"
+  "  --replay file: play no game, but sum up all game records of file and the\n"
+  "                 distribution of their scores by each set of '--rules'\n"
+  "  --rules r:     score games by rules r, 'default', 'classic' (each edge\n"
+  "                 marked costs 1, beams of an edge marked and atoms guessed\n"
+  "                 twice count once) or a file of 'key value' lines changing\n"
+  "                 the default: atom, exit, reflected, absorbed (points each),\n"
+  "                 dedup and atoms_once (0 or 1). Given more than once, games\n"
+  "                 are scored by the first, '--replay' uses all in one pass\n"
+  "  --index file:  play no game, but write an index of the game records of\n"
+  "                 file to 'file" IDX_SUFFIX "', boards equal but for rotations and\n"
+  "                 mirrors share their entries\n"
+  "  --find file:   play no game, but list all games of file played on a board\n"
+  "                 like the one of '--seed', '-s' and '-a', using its index\n"
+  "  --batch file:  replay games without prompts, each line of file holds\n"
+  "                 'seed size atoms' followed by the beams' entry numbers\n"
+  "                 and prints 'game seed entry exit' for each beam, where\n"
+  "                 exit is 'A' (absorbed), 'R' (reflected) or '?' (invalid)\n"
+  "  --simulate n:  play no game, but fire all beams into n random boards and\n"
+  "                 print each entry's count of absorbed, reflected and exited\n"
+  "                 beams, followed by the count of each exit as 'exit:count'\n"
+  "  --sparse:      keep just the atoms of each simulated board, sorted by row\n"
+  "                 and column, so huge boards fit and beams jump from atom to\n"
+  "                 atom. Prints no 'exit:count'. Works with '--simulate' only\n"
+  "  --enumerate file: play no game, but fire all beams into every board with\n"
+  "                 the atoms given, write their exits to file, a byte per\n"
+  "                 beam and boards in colex order of their atoms' inner cells,\n"
+  "                 print how many boards no beams can tell apart and as\n"
+  "                 'probes_needed' how many beams, picked greedily, tell\n"
+  "                 apart all the others, an upper bound of the fewest probes\n"
+  "                 needed\n"
+  "  --symmetry:    walk just one board of those equal but for rotations and\n"
+  "                 mirrors and put the exits of all 8 images into the table,\n"
+  "                 the same table and counts with about an 8th of the walks\n"
+  "  --serve addr:  play no game, but host many games at once on TCP port addr\n"
+  "                 or, if addr is no number, on Unix socket path addr. Each\n"
+  "                 connection plays one game like on the prompt\n"
+  "  --load n:      play no game, but fire n random probes into %d sessions\n"
+  "                 of the server's engine in process and print the probes/s\n"
+  "  --threads n:   spread simulation and advisor over n threads, or serve\n"
+  "                 sessions from n shards, one per thread (default all cores)\n"
   "  -h|--help:     print this help\n"
   "  -v|--version:  print version of program\n"
 //|************************ 80 chars width ****************************************|
          ,csMsg.cStr,
-         g_csMename.cStr, g_csMename.cStr
+         g_csMename.cStr, g_csMename.cStr, g_csMename.cStr, g_csMename.cStr,
+         g_csMename.cStr, g_csMename.cStr, g_csMename.cStr, g_csMename.cStr,
+         g_csMename.cStr, g_csMename.cStr, LOAD_SESSIONS
         );
 
   if (iErr == ERR_NOERR)
@@ -213,6 +846,242 @@ void dispatchError(int rv, const char* pcMsg) {
   usage(rv, csErr.cStr);
 }
 
+/*******************************************************************************
+ * Name:  loadRules
+ * Purpose: Loads the rules of a preset's name or a file of 'key value' lines,
+ *          which change the default rules. '#' starts a comment.
+ *******************************************************************************/
+void loadRules(t_rules* ptRules, const char* pcSpec) {
+  FILE* hFile    = NULL;
+  cstr  csLine   = csNew("");
+  cstr  csMsg    = csNew("");
+  char  acKey[32];
+  int   iValue   = 0;
+  int   iLine    = 0;
+
+  for (size_t i = 0; i < sizeof(g_atPresets) / sizeof(g_atPresets[0]); ++i) {
+    if (!strcmp(pcSpec, g_atPresets[i].acName)) {
+      *ptRules = g_atPresets[i];
+      csFree(&csLine);
+      csFree(&csMsg);
+      return;
+    }
+  }
+
+  *ptRules = g_atPresets[0];
+  snprintf(ptRules->acName, sizeof(ptRules->acName), "%s", pcSpec);
+
+  hFile = openFile(pcSpec, "r");
+  while (csReadLine(&csLine, hFile)) {
+    if (csLine.len == 0 && feof(hFile))
+      break;
+    ++iLine;
+    if (sscanf(csLine.cStr, "%31s", acKey) != 1 || acKey[0] == '#')
+      continue;
+
+    if (sscanf(csLine.cStr, "%31s %20d", acKey, &iValue) != 2) {
+      csSetf(&csMsg, "No value in line %d of '%s'", iLine, pcSpec);
+      dispatchError(ERR_ARGS, csMsg.cStr);
+    }
+    if      (!strcmp(acKey, "atom"))       ptRules->iAtom      = iValue;
+    else if (!strcmp(acKey, "exit"))       ptRules->iExit      = iValue;
+    else if (!strcmp(acKey, "reflected"))  ptRules->iReflected = iValue;
+    else if (!strcmp(acKey, "absorbed"))   ptRules->iAbsorbed  = iValue;
+    else if (!strcmp(acKey, "dedup"))      ptRules->bDedup     = iValue != 0;
+    else if (!strcmp(acKey, "atoms_once")) ptRules->bAtomsOnce = iValue != 0;
+    else {
+      csSetf(&csMsg, "Unknown rule '%s' in line %d of '%s'", acKey, iLine, pcSpec);
+      dispatchError(ERR_ARGS, csMsg.cStr);
+    }
+  }
+
+  fclose(hFile);
+  csFree(&csLine);
+  csFree(&csMsg);
+}
+
+/*******************************************************************************
+ * Name:  initScorer
+ * Purpose: Sets up scoring by a set of rules, games start with startScore().
+ *******************************************************************************/
+void initScorer(t_scorer* ptSc, const t_rules* ptRules) {
+  memset(ptSc, 0, sizeof(t_scorer));
+  ptSc->ptRules = ptRules;
+}
+
+/*******************************************************************************
+ * Name:  freeScorer
+ * Purpose: Frees the scorer's stamps.
+ *******************************************************************************/
+void freeScorer(t_scorer* ptSc) {
+  free(ptSc->pauiEdges);
+  free(ptSc->pauiCells);
+  ptSc->pauiEdges = NULL;
+  ptSc->pauiCells = NULL;
+}
+
+/*******************************************************************************
+ * Name:  startScore
+ * Purpose: Starts the score of a new game on a board of iSize. A new stamp
+ *          forgets the edges and cells of the last game at once.
+ *******************************************************************************/
+void startScore(t_scorer* ptSc, int iSize) {
+  // Stamps are kept for boards as large as the largest one so far, they're
+  // cleared just if the stamp wraps around.
+  if (iSize > ptSc->iSize || ++ptSc->uiGame == 0) {
+    if (iSize > ptSc->iSize)
+      ptSc->iSize = iSize;
+    freeScorer(ptSc);
+    if (ptSc->ptRules->bDedup)
+      ptSc->pauiEdges = (uint32_t*) calloc(4 * (size_t) ptSc->iSize + 1, sizeof(uint32_t));
+    if (ptSc->ptRules->bAtomsOnce)
+      ptSc->pauiCells = (uint32_t*) calloc((size_t) ptSc->iSize * (size_t) ptSc->iSize, sizeof(uint32_t));
+    ptSc->uiGame = 1;
+  }
+
+  ptSc->iFound = 0;
+  memset(&ptSc->tScore, 0, sizeof(t_score));
+}
+
+/*******************************************************************************
+ * Name:  scoreBeam
+ * Purpose: Scores a beam fired, 'iExit' 0 if absorbed.
+ *******************************************************************************/
+void scoreBeam(t_scorer* ptSc, int iEntry, int iExit) {
+  // The outcome of an edge marked already is known, both ways.
+  if (ptSc->pauiEdges != NULL) {
+    if (ptSc->pauiEdges[iEntry] == ptSc->uiGame)
+      return;
+    ptSc->pauiEdges[iEntry] = ptSc->uiGame;
+    ptSc->pauiEdges[iExit]  = ptSc->uiGame;
+  }
+
+  if (iExit == 0)
+    ++ptSc->tScore.iAbsorbed;
+  else if (iExit == iEntry)
+    ++ptSc->tScore.iReflected;
+  else
+    ++ptSc->tScore.iExited;
+}
+
+/*******************************************************************************
+ * Name:  scoreGuess
+ * Purpose: Scores a guess of inner cell y * size + x, counted from 0.
+ *******************************************************************************/
+void scoreGuess(t_scorer* ptSc, int iCell, int bAtom) {
+  if (ptSc->pauiCells == NULL) {
+    if (!bAtom)
+      ++ptSc->tScore.iMissedAtoms;
+    return;
+  }
+
+  if (bAtom && ptSc->pauiCells[iCell] != ptSc->uiGame) {
+    ptSc->pauiCells[iCell] = ptSc->uiGame;
+    ++ptSc->iFound;
+  }
+}
+
+/*******************************************************************************
+ * Name:  endScore
+ * Purpose: Ends the score of a game with iAtomNo atoms hidden.
+ *******************************************************************************/
+void endScore(t_scorer* ptSc, int iAtomNo) {
+  if (ptSc->pauiCells != NULL)
+    ptSc->tScore.iMissedAtoms = iAtomNo - ptSc->iFound;
+}
+
+/*******************************************************************************
+ * Name:  scoreTotal
+ * Purpose: Returns the total of a score by a set of rules.
+ *******************************************************************************/
+ll scoreTotal(const t_rules* ptRules, const t_score* ptScore) {
+  return (ll) ptRules->iAtom      * ptScore->iMissedAtoms +
+         (ll) ptRules->iExit      * ptScore->iExited      +
+         (ll) ptRules->iReflected * ptScore->iReflected   +
+         (ll) ptRules->iAbsorbed  * ptScore->iAbsorbed;
+}
+
+/*******************************************************************************
+ * Name:  addStats
+ * Purpose: Adds a game's score to the distribution.
+ *******************************************************************************/
+void addStats(t_scoreStats* ptStats, ll llScore) {
+  double dDelta  = 0.0;
+  ll     llLow   = 0;
+  ll     llBins  = 0;
+  ll*    pallNew = NULL;
+
+  // Histogram grows to twice its bins or more, to the side of the score.
+  if (ptStats->pallHist == NULL) {
+    ptStats->llLow    = llScore - STATS_BINS / 2;
+    ptStats->llBins   = STATS_BINS;
+    ptStats->pallHist = (ll*) calloc(STATS_BINS, sizeof(ll));
+  }
+  else if (llScore < ptStats->llLow || llScore >= ptStats->llLow + ptStats->llBins) {
+    llBins = 2 * ptStats->llBins;
+    if (llBins < ptStats->llBins + llabs(llScore - ptStats->llLow))
+      llBins = ptStats->llBins + llabs(llScore - ptStats->llLow);
+    llLow  = (llScore < ptStats->llLow) ? ptStats->llLow + ptStats->llBins - llBins : ptStats->llLow;
+    pallNew = (ll*) calloc((size_t) llBins, sizeof(ll));
+    memcpy(pallNew + (ptStats->llLow - llLow), ptStats->pallHist, sizeof(ll) * (size_t) ptStats->llBins);
+    free(ptStats->pallHist);
+    ptStats->pallHist = pallNew;
+    ptStats->llLow    = llLow;
+    ptStats->llBins   = llBins;
+  }
+  ++ptStats->pallHist[llScore - ptStats->llLow];
+
+  if (ptStats->llGames == 0 || llScore < ptStats->llMin) ptStats->llMin = llScore;
+  if (ptStats->llGames == 0 || llScore > ptStats->llMax) ptStats->llMax = llScore;
+  ++ptStats->llGames;
+  dDelta          = (double) llScore - ptStats->dMean;
+  ptStats->dMean += dDelta / (double) ptStats->llGames;
+  ptStats->dM2   += dDelta * ((double) llScore - ptStats->dMean);
+}
+
+/*******************************************************************************
+ * Name:  statsPercentile
+ * Purpose: Returns the lowest score, which at least dShare of all games don't
+ *          exceed.
+ *******************************************************************************/
+ll statsPercentile(const t_scoreStats* ptStats, double dShare) {
+  ll llNeeded = (ll) ceil(dShare * (double) ptStats->llGames);
+  ll llSum    = 0;
+
+  for (ll i = 0; i < ptStats->llBins; ++i) {
+    llSum += ptStats->pallHist[i];
+    if (llSum >= llNeeded && llSum > 0)
+      return ptStats->llLow + i;
+  }
+
+  return ptStats->llMax;
+}
+
+/*******************************************************************************
+ * Name:  printStats
+ * Purpose: Prints the score distribution of a set of rules, with each score
+ *          played as 'score:games'.
+ *******************************************************************************/
+void printStats(const t_rules* ptRules, const t_scoreStats* ptStats) {
+  printf("rules %s\n", ptRules->acName);
+  printf("score_min %lld\n", ptStats->llMin);
+  printf("score_max %lld\n", ptStats->llMax);
+  printf("score_mean %.3f\n", ptStats->dMean);
+  printf("score_stddev %.3f\n", (ptStats->llGames < 2) ? 0.0 : sqrt(ptStats->dM2 / (double) (ptStats->llGames - 1)));
+  if (ptStats->llGames == 0)
+    return;
+
+  printf("score_p10 %lld\n", statsPercentile(ptStats, 0.10));
+  printf("score_p50 %lld\n", statsPercentile(ptStats, 0.50));
+  printf("score_p90 %lld\n", statsPercentile(ptStats, 0.90));
+  printf("score_p99 %lld\n", statsPercentile(ptStats, 0.99));
+  printf("score_hist");
+  for (ll i = 0; i < ptStats->llBins; ++i)
+    if (ptStats->pallHist[i] != 0)
+      printf(" %lld:%lld", ptStats->llLow + i, ptStats->pallHist[i]);
+  printf("\n");
+}
+
 /*******************************************************************************
  * Name:  getOptions
  * Purpose: Filters command line.
@@ -224,15 +1093,33 @@ void getOptions(int argc, char* argv[]) {
   char cOpt   = 0;
 
   // Set defaults.
-  g_tOpts.iAtomNo = 4;
-  g_tOpts.iSize   = 8;
-  g_tOpts.bPrtBrd = 0;
+  g_tOpts.iAtomNo    = 4;
+  g_tOpts.iSize      = 8;
+  g_tOpts.bPrtBrd    = 0;
+  g_tOpts.bTui       = 0;
+  g_tOpts.iFormat    = FORMAT_TEXT;
+  g_tOpts.bBatch     = 0;
+  g_tOpts.bBitboard  = 0;
+  g_tOpts.bSymmetry  = 0;
+  g_tOpts.bSparse    = 0;
+  g_tOpts.iThreads   = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  g_tOpts.llSimulate = 0;
+  g_tOpts.llLoad     = 0;
+  g_tOpts.llSeed     = (ll) time(NULL);
+  g_tOpts.csBatch    = csNew("");
+  g_tOpts.bServe     = 0;
+  g_tOpts.csServe    = csNew("");
+  g_tOpts.bReplay    = 0;
+  g_tOpts.csRecord   = csNew("");
+  g_tOpts.csReplay   = csNew("");
+  g_tOpts.bIndex     = 0;
+  g_tOpts.bFind      = 0;
+  g_tOpts.csIndex    = csNew("");
+  g_tOpts.csFind     = csNew("");
+  g_tOpts.bEnumerate = 0;
+  g_tOpts.csEnumerate = csNew("");
 
-  // Set score to zero.
-  g_tScore.iMissedAtoms = 0;
-  g_tScore.iAbsorbed    = 0;
-  g_tScore.iReflected   = 0;
-  g_tScore.iExited      = 0;
+  g_tOpts.iRules     = 0;
 
   // Init free argument's dynamic array.
   daInit(cstr, g_tArgs);
@@ -253,6 +1140,102 @@ next_argument:
       if (!strcmp(csArgv.cStr, "--version")) {
         version();
       }
+      if (!strcmp(csArgv.cStr, "--batch")) {
+        if (! getArgStr(&g_tOpts.csBatch, &iArg, argc, argv, ARG_CLI, NULL))
+          dispatchError(ERR_ARGS, "Batch file name missing");
+        g_tOpts.bBatch = 1;
+        continue;
+      }
+      if (!strcmp(csArgv.cStr, "--serve")) {
+        if (! getArgStr(&g_tOpts.csServe, &iArg, argc, argv, ARG_CLI, NULL))
+          dispatchError(ERR_ARGS, "Port or socket path missing");
+        g_tOpts.bServe = 1;
+        continue;
+      }
+      if (!strcmp(csArgv.cStr, "--record")) {
+        if (! getArgStr(&g_tOpts.csRecord, &iArg, argc, argv, ARG_CLI, NULL))
+          dispatchError(ERR_ARGS, "Record file name missing");
+        continue;
+      }
+      if (!strcmp(csArgv.cStr, "--replay")) {
+        if (! getArgStr(&g_tOpts.csReplay, &iArg, argc, argv, ARG_CLI, NULL))
+          dispatchError(ERR_ARGS, "Replay file name missing");
+        g_tOpts.bReplay = 1;
+        continue;
+      }
+      if (!strcmp(csArgv.cStr, "--index")) {
+        if (! getArgStr(&g_tOpts.csIndex, &iArg, argc, argv, ARG_CLI, NULL))
+          dispatchError(ERR_ARGS, "Record file name missing");
+        g_tOpts.bIndex = 1;
+        continue;
+      }
+      if (!strcmp(csArgv.cStr, "--find")) {
+        if (! getArgStr(&g_tOpts.csFind, &iArg, argc, argv, ARG_CLI, NULL))
+          dispatchError(ERR_ARGS, "Record file name missing");
+        g_tOpts.bFind = 1;
+        continue;
+      }
+      if (!strcmp(csArgv.cStr, "--enumerate")) {
+        if (! getArgStr(&g_tOpts.csEnumerate, &iArg, argc, argv, ARG_CLI, NULL))
+          dispatchError(ERR_ARGS, "Table file name missing");
+        g_tOpts.bEnumerate = 1;
+        continue;
+      }
+      if (!strcmp(csArgv.cStr, "--sparse")) {
+        g_tOpts.bSparse = 1;
+        continue;
+      }
+      if (!strcmp(csArgv.cStr, "--symmetry")) {
+        g_tOpts.bSymmetry = 1;
+        continue;
+      }
+      if (!strcmp(csArgv.cStr, "--rules")) {
+        if (! getArgStr(&csArgv, &iArg, argc, argv, ARG_CLI, NULL))
+          dispatchError(ERR_ARGS, "Rules missing");
+        if (g_tOpts.iRules == RULES_MAX)
+          dispatchError(ERR_ARGS, "Too many rules");
+        loadRules(&g_tOpts.atRules[g_tOpts.iRules++], csArgv.cStr);
+        continue;
+      }
+      if (!strcmp(csArgv.cStr, "--format")) {
+        if (! getArgStr(&csArgv, &iArg, argc, argv, ARG_CLI, NULL))
+          dispatchError(ERR_ARGS, "Format missing");
+        if (!strcmp(csArgv.cStr, "json"))
+          g_tOpts.iFormat = FORMAT_JSON;
+        else if (!strcmp(csArgv.cStr, "csv"))
+          g_tOpts.iFormat = FORMAT_CSV;
+        else
+          dispatchError(ERR_ARGS, "Format must be json or csv");
+        continue;
+      }
+      if (!strcmp(csArgv.cStr, "--tui")) {
+        g_tOpts.bTui = 1;
+        continue;
+      }
+      if (!strcmp(csArgv.cStr, "--bitboard")) {
+        g_tOpts.bBitboard = 1;
+        continue;
+      }
+      if (!strcmp(csArgv.cStr, "--simulate")) {
+        if (! getArgLong(&g_tOpts.llSimulate, &iArg, argc, argv, ARG_CLI, NULL))
+          dispatchError(ERR_ARGS, "No valid count of boards or missing");
+        continue;
+      }
+      if (!strcmp(csArgv.cStr, "--load")) {
+        if (! getArgLong(&g_tOpts.llLoad, &iArg, argc, argv, ARG_CLI, NULL))
+          dispatchError(ERR_ARGS, "No valid count of probes or missing");
+        continue;
+      }
+      if (!strcmp(csArgv.cStr, "--seed")) {
+        if (! getArgLong(&g_tOpts.llSeed, &iArg, argc, argv, ARG_CLI, NULL))
+          dispatchError(ERR_ARGS, "No valid seed or missing");
+        continue;
+      }
+      if (!strcmp(csArgv.cStr, "--threads")) {
+        if (! getArgInt(&g_tOpts.iThreads, &iArg, argc, argv, ARG_CLI, NULL))
+          dispatchError(ERR_ARGS, "No valid count of threads or missing");
+        continue;
+      }
       dispatchError(ERR_ARGS, "Invalid long option");
     }
 
@@ -267,12 +1250,12 @@ next_argument:
           version();
         }
         if (cOpt == 'a') {
-          if (! getArgLong((ll*) &g_tOpts.iAtomNo, &iArg, argc, argv, ARG_CLI, NULL))
+          if (! getArgInt(&g_tOpts.iAtomNo, &iArg, argc, argv, ARG_CLI, NULL))
             dispatchError(ERR_ARGS, "No valid count of atoms or missing");
           continue;
         }
         if (cOpt == 's') {
-          if (! getArgLong((ll*) &g_tOpts.iSize, &iArg, argc, argv, ARG_CLI, NULL))
+          if (! getArgInt(&g_tOpts.iSize, &iArg, argc, argv, ARG_CLI, NULL))
             dispatchError(ERR_ARGS, "No valid size or missing");
           continue;
         }
@@ -292,12 +1275,27 @@ next_argument:
   if (g_tArgs.sCount != 0)
     dispatchError(ERR_ARGS, "No file names needed");
 
-  // Grids cell count is size plus two edges squared.
-  g_tOpts.iWidth  = g_tOpts.iSize  + 2;
-  g_tOpts.iCellNo = g_tOpts.iWidth * g_tOpts.iWidth;
-
-  // sizeof() yields an unsigned integer!
-  g_paiGrid = (int*) malloc(sizeof(int) * (uint) g_tOpts.iCellNo);
+  if (g_tOpts.iSize < 1)
+    dispatchError(ERR_ARGS, "Size must be at least 1");
+  if (g_tOpts.bSparse && (g_tOpts.llSimulate == 0 || g_tOpts.bReplay || g_tOpts.bIndex || g_tOpts.bFind ||
+                          g_tOpts.bEnumerate || g_tOpts.bBatch || g_tOpts.bServe || g_tOpts.llLoad > 0))
+    dispatchError(ERR_ARGS, "'--sparse' works with '--simulate' only");
+  if (!g_tOpts.bSparse && g_tOpts.iSize > GRID_MAX_SIZE)
+    dispatchError(ERR_ARGS, "Board too large for a grid, simulate it with '--sparse'");
+  if (g_tOpts.iAtomNo < 0 || g_tOpts.iAtomNo > (ll) g_tOpts.iSize * g_tOpts.iSize)
+    dispatchError(ERR_ARGS, "Count of atoms doesn't fit into the grid");
+  if (g_tOpts.llSimulate < 0)
+    dispatchError(ERR_ARGS, "Count of boards can't be negative");
+  if (g_tOpts.llLoad < 0)
+    dispatchError(ERR_ARGS, "Count of probes can't be negative");
+  if (g_tOpts.csRecord.len != 0 && g_tOpts.iSize > REC_MAX_SIZE)
+    dispatchError(ERR_ARGS, "Board too large to be recorded");
+  if (g_tOpts.bSparse && g_tOpts.iAtomNo > (ll) g_tOpts.iSize * g_tOpts.iSize / 2)
+    dispatchError(ERR_ARGS, "Sparse boards take at most half of the cells as atoms");
+  if (g_tOpts.iThreads < 1)
+    g_tOpts.iThreads = 1;
+  if (g_tOpts.iRules == 0)
+    loadRules(&g_tOpts.atRules[g_tOpts.iRules++], "default");
 
   // Free string memory.
   csFree(&csArgv);
@@ -342,41 +1340,86 @@ void printIntro(void) {
   printf("\n");
   printf("If you think you know where all atoms are you can enter (e)nd or\n");
   printf("(f)inish to proceed to enter your solution or enter (q)uit to exit the\n");
-  printf("current game.\n");
+  printf("current game. Enter (s)olve to see what all beams so far tell about\n");
+  printf("the atoms or (a)dvise to get the beams telling the most.\n");
   printf("\n");
   printf("After you entered the guessed locations of all the hidden atoms, you get\n");
   printf("the result of this game, which is calculated as follows:\n");
-  printf("Each wrong guessed atom %d points\n", SCORE_ATOM);
-  printf("Each beam that exited   %d points\n", SCORE_EXIT);
-  printf("Each reflected beam     %d points\n", SCORE_REFLECTED);
-  printf("Each absorbed beam      %d points\n", SCORE_ABSORBED);
+  printf("Each wrong guessed atom %d points\n", g_tOpts.atRules[0].iAtom);
+  printf("Each beam that exited   %d points\n", g_tOpts.atRules[0].iExit);
+  printf("Each reflected beam     %d points\n", g_tOpts.atRules[0].iReflected);
+  printf("Each absorbed beam      %d points\n", g_tOpts.atRules[0].iAbsorbed);
+  if (g_tOpts.atRules[0].bDedup)
+    printf("A beam from an edge marked already scores nothing.\n");
+  if (g_tOpts.atRules[0].bAtomsOnce)
+    printf("Each atom not found counts as wrong, guessing one twice won't do.\n");
 }
 
 /*******************************************************************************
  * Name:  cellToXY
  * Purpose: Converts a cell index into x and y coordinates.
  *******************************************************************************/
-void cellToXY(int iCell, int* piX, int* piY) {
-  *piX = iCell % g_tOpts.iWidth;
-  *piY = iCell / g_tOpts.iWidth;
+void cellToXY(t_board* ptBoard, int iCell, int* piX, int* piY) {
+  *piX = iCell % ptBoard->iWidth;
+  *piY = iCell / ptBoard->iWidth;
 }
 
 /*******************************************************************************
  * Name:  cellFromXY
  * Purpose: Converts x and y coordinates into a cell index.
  *******************************************************************************/
-void cellFromXY(int* piCell, int iX, int iY) {
-  *piCell = iX + g_tOpts.iWidth * iY;
+void cellFromXY(t_board* ptBoard, int* piCell, int iX, int iY) {
+  *piCell = iX + ptBoard->iWidth * iY;
 }
 
 /*******************************************************************************
- * Name:  createBoard
- * Purpose: Creates the board with border and atoms.
+ * Name:  setAtom
+ * Purpose: Sets or removes an atom in the grid and in the bitmasks.
+ *******************************************************************************/
+void setAtom(t_board* ptBoard, int iCell, int bAtom) {
+  int      iX      = iCell % ptBoard->iWidth;
+  int      iY      = iCell / ptBoard->iWidth;
+  uint64_t ullRow  = 1ULL << (iX % BITS_WORD);
+  uint64_t ullCol  = 1ULL << (iY % BITS_WORD);
+  int      iRowOff = iY * ptBoard->iWords + iX / BITS_WORD;
+  int      iColOff = iX * ptBoard->iWords + iY / BITS_WORD;
+
+  if (bAtom) {
+    ptBoard->paiGrid[iCell]       = CELL_ATOM;
+    ptBoard->paullRows[iRowOff] |= ullRow;
+    ptBoard->paullCols[iColOff] |= ullCol;
+  }
+  else {
+    ptBoard->paiGrid[iCell]       = CELL_EMPTY;
+    ptBoard->paullRows[iRowOff] &= ~ullRow;
+    ptBoard->paullCols[iColOff] &= ~ullCol;
+  }
+}
+
+/*******************************************************************************
+ * Name:  clearAtoms
+ * Purpose: Takes all atoms away and undoes their picks in the list of cells.
  *******************************************************************************/
-void createBoard() {
+void clearAtoms(t_board* ptBoard) {
+  int iTmp = 0;
+
+  // Undo swaps backwards, so the same seed always gives the same board.
+  for (int i = ptBoard->iAtomsSet - 1; i >= 0; --i) {
+    setAtom(ptBoard, ptBoard->paiAtoms[i], 0);
+    iTmp                                   = ptBoard->paiFree[i];
+    ptBoard->paiFree[i]                    = ptBoard->paiFree[ptBoard->paiPicks[i]];
+    ptBoard->paiFree[ptBoard->paiPicks[i]] = iTmp;
+  }
+
+  ptBoard->iAtomsSet = 0;
+}
+
+/*******************************************************************************
+ * Name:  initBoard
+ * Purpose: Sets board's dimensions and (re)allocates its memory accordingly.
+ *******************************************************************************/
+void initBoard(t_board* ptBoard, int iSize, int iAtomNo, int bBitboard) {
   int iCell = 0;
-  int iX    = 0;
-  int iY    = 0;
 
   // Internal 4x4 grid looks like this:
   //     16151413
@@ -388,345 +1431,4730 @@ void createBoard() {
   //   1 1 1 1 1 1
   //     5 6 7 8
 
-  // Create default board.
-  for (iY = 0; iY < g_tOpts.iWidth; ++iY) {
-    for (iX = 0; iX < g_tOpts.iWidth; ++iX) {
-       cellFromXY(&iCell, iX, iY);
-       if (iX == 0 || iX == g_tOpts.iWidth - 1 ||
-           iY == 0 || iY == g_tOpts.iWidth - 1)
-         g_paiGrid[iCell] = CELL_BORDER;
-       else
-         g_paiGrid[iCell] = CELL_EMPTY;
-    }
+  // Same dimensions, just take the old atoms away.
+  if (ptBoard->paiGrid != NULL && ptBoard->iSize == iSize) {
+    clearAtoms(ptBoard);
   }
+  else {
+    ptBoard->iSize = iSize;
+
+    // Grids cell count is size plus two edges squared.
+    ptBoard->iWidth  = ptBoard->iSize  + 2;
+    ptBoard->iCellNo = ptBoard->iWidth * ptBoard->iWidth;
+
+    // Steps per direction, the left of each direction is the next one.
+    ptBoard->aiAhead[DIR_UP]    = -ptBoard->iWidth;
+    ptBoard->aiAhead[DIR_LEFT]  = -1;
+    ptBoard->aiAhead[DIR_DOWN]  =  ptBoard->iWidth;
+    ptBoard->aiAhead[DIR_RIGHT] =  1;
+    for (int iDir = DIR_UP; iDir <= DIR_RIGHT; ++iDir)
+      ptBoard->aiSide[iDir] = ptBoard->aiAhead[iDir % 4 + 1];
 
-  // Seed pseudo random generator;
-  srand((uint) time(NULL));
+    // sizeof() yields an unsigned integer! Products in size_t, as a grid up
+    // to GRID_MAX_SIZE has more bytes than fit into an int.
+    ptBoard->paiGrid  = (int*) realloc(ptBoard->paiGrid,  sizeof(int) * (size_t) ptBoard->iCellNo);
+    ptBoard->paiExits = (int*) realloc(ptBoard->paiExits, sizeof(int) * (size_t) (4 * ptBoard->iSize + 1));
+    ptBoard->paiFree  = (int*) realloc(ptBoard->paiFree,  sizeof(int) * (size_t) iSize * (size_t) iSize);
+    ptBoard->paiEntries = (int*) realloc(ptBoard->paiEntries, sizeof(int) * (size_t) (4 * ptBoard->iSize + 1));
+    ptBoard->paiDirs    = (int*) realloc(ptBoard->paiDirs,    sizeof(int) * (size_t) (4 * ptBoard->iSize + 1));
+    ptBoard->paiOuts    = (int*) realloc(ptBoard->paiOuts,    sizeof(int) * (size_t) (4 * ptBoard->iSize + 1));
 
-  // Set atoms into the board.
-  for (int i = 0; i < g_tOpts.iAtomNo; ++i) {
-    // First set iCell to non empty cell.
-    iCell = 0;
-    // Get new cell, until it's empty.
-    while (g_paiGrid[iCell] != CELL_EMPTY)
-      iCell = rand() % g_tOpts.iCellNo;
-    // Set atom to this cell.
-    g_paiGrid[iCell] = CELL_ATOM;
+    // One bitmask line per row and column, each line spans the full width.
+    ptBoard->iWords    = (ptBoard->iWidth + BITS_WORD - 1) / BITS_WORD;
+    ptBoard->paullRows = (uint64_t*) realloc(ptBoard->paullRows, sizeof(uint64_t) * (size_t) (ptBoard->iWords * ptBoard->iWidth));
+    ptBoard->paullCols = (uint64_t*) realloc(ptBoard->paullCols, sizeof(uint64_t) * (size_t) (ptBoard->iWords * ptBoard->iWidth));
+    if (ptBoard->paiGrid    == NULL || ptBoard->paiExits  == NULL || ptBoard->paiFree   == NULL ||
+        ptBoard->paiEntries == NULL || ptBoard->paiDirs   == NULL || ptBoard->paiOuts   == NULL ||
+        ptBoard->paullRows  == NULL || ptBoard->paullCols == NULL)
+      dispatchError(ERR_ELSE, "Can't allocate board");
+    memset(ptBoard->paullRows, 0, sizeof(uint64_t) * (size_t) (ptBoard->iWords * ptBoard->iWidth));
+    memset(ptBoard->paullCols, 0, sizeof(uint64_t) * (size_t) (ptBoard->iWords * ptBoard->iWidth));
+
+    // Create default board and list all of its inner cells.
+    for (int iY = 0; iY < ptBoard->iWidth; ++iY) {
+      for (int iX = 0; iX < ptBoard->iWidth; ++iX) {
+         cellFromXY(ptBoard, &iCell, iX, iY);
+         if (iX == 0 || iX == ptBoard->iWidth - 1 ||
+             iY == 0 || iY == ptBoard->iWidth - 1)
+           ptBoard->paiGrid[iCell] = CELL_BORDER;
+         else
+           ptBoard->paiGrid[iCell] = CELL_EMPTY;
+      }
+    }
+    for (int i = 0; i < iSize * iSize; ++i)
+      cellFromXY(ptBoard, &ptBoard->paiFree[i], i % iSize + 1, i / iSize + 1);
   }
+
+  ptBoard->iAtomNo   = iAtomNo;
+  ptBoard->iAtomsSet = 0;
+  ptBoard->bBitboard = bBitboard;
+  ptBoard->paiAtoms  = (int*) realloc(ptBoard->paiAtoms, sizeof(int) * (size_t) (iAtomNo + 1));
+  ptBoard->paiPicks  = (int*) realloc(ptBoard->paiPicks, sizeof(int) * (size_t) (iAtomNo + 1));
+  if (ptBoard->paiAtoms == NULL || ptBoard->paiPicks == NULL)
+    dispatchError(ERR_ELSE, "Can't allocate board");
 }
 
 /*******************************************************************************
- * Name:  printBoard
- * Purpose: Prints the board with or without the solution.
+ * Name:  freeBoard
+ * Purpose: Frees board's memory, so it can be initialised again.
  *******************************************************************************/
-void printBoard(int bWithSolution) {
-  cstr csLine = csNew("");
-  int  iCell  = 0;
-  int  iX     = 0;
-  int  iY     = 0;
-
-  //     16  15  14  13
-  //    +---+---+---+---+
-  //  1 |   |   |   |   | 12
-  //    +---+---+---+---+
-  //  2 |   |   | X |   | 11
-  //    +---+---+---+---+
-  //  3 |   |   |   |   | 10
-  //    +---+---+---+---+
-  //  4 |   | X | X |   |  9
-  //    +---+---+---+---+
-  //      5   6   7   8
-
-  // Assemble horizontal line.
-  csSet(&csLine, "+");
-  for (int i = 0; i < g_tOpts.iSize; ++i)
-    csCat(&csLine, csLine.cStr, "---+");
-
-  // Help text.
-  printf("\n\n");
-  printf("Atoms hidden = %d\n\n", g_tOpts.iAtomNo);
+void freeBoard(t_board* ptBoard) {
+  free(ptBoard->paiGrid);
+  free(ptBoard->paiExits);
+  free(ptBoard->paiFree);
+  free(ptBoard->paiAtoms);
+  free(ptBoard->paiPicks);
+  free(ptBoard->paullRows);
+  free(ptBoard->paullCols);
+  free(ptBoard->paiEntries);
+  free(ptBoard->paiDirs);
+  free(ptBoard->paiOuts);
+  memset(ptBoard, 0, sizeof(t_board));
+}
 
-  // Top numbers.
-  printf("    ");
-  for (iX = 0; iX < g_tOpts.iSize; ++iX)
-    printf("%3d ", 4 * g_tOpts.iSize - iX);
-  printf("\n");
+/*******************************************************************************
+ * Name:  createBoard
+ * Purpose: Sets new atoms into the board, the random state belongs to caller.
+ *******************************************************************************/
+void createBoard(t_board* ptBoard, t_rand* ptRand) {
+  int iFree = ptBoard->iSize * ptBoard->iSize;
+  int iPick = 0;
+  int iTmp  = 0;
 
-  // First horizontal line.
-  printf("    %s\n", csLine.cStr);
+  clearAtoms(ptBoard);
 
-  // Rest of the board.
+  // Partial Fisher-Yates, the first i inner cells are the atoms.
+  for (int i = 0; i < ptBoard->iAtomNo; ++i) {
+    iPick = i + (int) randBelow(ptRand, (uint64_t) (iFree - i));
+    iTmp                    = ptBoard->paiFree[i];
+    ptBoard->paiFree[i]     = ptBoard->paiFree[iPick];
+    ptBoard->paiFree[iPick] = iTmp;
+    ptBoard->paiPicks[i]    = iPick;
+    ptBoard->paiAtoms[i]    = ptBoard->paiFree[i];
+    setAtom(ptBoard, ptBoard->paiAtoms[i], 1);
+  }
 
-  // Cells line plus horizontal line 'iSize' times.
-  for (iY = 0; iY < g_tOpts.iSize; ++iY) {
+  ptBoard->iAtomsSet = ptBoard->iAtomNo;
+}
 
-    // Left number.
-    printf("%3d |", iY + 1);
+/*******************************************************************************
+ * Name:  symmetricXY
+ * Purpose: Maps inner cell (x, y), counted from 0, by one of the symmetries of
+ *          the square. 0 is identity, 1 to 3 are rotations, 4 to 7 mirrors.
+ *******************************************************************************/
+static inline void symmetricXY(int iSym, int iSize, int iX, int iY, int* piX, int* piY) {
+  int n = iSize - 1;
 
-    for (iX = 0; iX < g_tOpts.iSize; ++iX) {
-      cellFromXY(&iCell, iX + 1, iY + 1);
-      if (bWithSolution == BOARD_SOLUTION && g_paiGrid[iCell] == CELL_ATOM)
-        printf(" X |");
-      else
-        printf("   |");
-    }
-    // Right number.
-    printf("%3d ", 3 * g_tOpts.iSize - iY);
-    // Horizontal line.
-    printf("\n    %s\n", csLine.cStr);
+  switch (iSym) {
+    case 0:  *piX = iX;     *piY = iY;     break;
+    case 1:  *piX = n - iY; *piY = iX;     break;
+    case 2:  *piX = n - iX; *piY = n - iY; break;
+    case 3:  *piX = iY;     *piY = n - iX; break;
+    case 4:  *piX = n - iX; *piY = iY;     break;
+    case 5:  *piX = iX;     *piY = n - iY; break;
+    case 6:  *piX = iY;     *piY = iX;     break;
+    default: *piX = n - iY; *piY = n - iX; break;
   }
+}
 
-  // Bottom numbers.
-  printf("    ");
-  for (iX = 1; iX <= g_tOpts.iSize; ++iX)
-    printf("%3d ", g_tOpts.iSize + iX);
-  printf("\n\n");
+/*******************************************************************************
+ * Name:  compareInt
+ * Purpose: Compares two ints for qsort().
+ *******************************************************************************/
+int compareInt(const void* pvA, const void* pvB) {
+  int iA = *(const int*) pvA;
+  int iB = *(const int*) pvB;
+
+  return (iA > iB) - (iA < iB);
 }
 
 /*******************************************************************************
- * Name:  getEntryNode
- * Purpose: Translate Entry number (iBeam) into according edge cell (iX, iY).
+ * Name:  symmetricEdge
+ * Purpose: Maps an edge node by one of the symmetries of the square, like its
+ *          border cell in symmetricXY(). Node 0, absorbed, stays 0.
  *******************************************************************************/
-cstr getEntryNode(int* piEntryCell, int* piDirection) {
-  cstr csBeam = csNew("");
-  int  iBeam  = 0;
-  int  iX     = 0;
-  int  iY     = 0;
+int symmetricEdge(int iSym, int iSize, int iEdge) {
+  int n  = iSize;
+  int iX = 0;
+  int iY = 0;
 
-  csInput("Enter beam 's entry number: ", &csBeam);
-  iBeam = (int) cstr2ll(csBeam);
+  if (iEdge < 1 || iEdge > 4 * n)
+    return 0;
 
-  // Security check.
-  if (iBeam < 1 || iBeam > g_tOpts.iCellNo - 1) {
-    *piEntryCell = -1;
-    return csBeam;
-  }
+  // Border cell like getEdgeCell(), counted from -1 to n.
+  if      (iEdge <= n)     { iX = -1;               iY = iEdge - 1;         }
+  else if (iEdge <= 2 * n) { iX = iEdge - n - 1;    iY = n;                 }
+  else if (iEdge <= 3 * n) { iX = n;                iY = 3 * n - iEdge;     }
+  else                     { iX = 4 * n - iEdge;    iY = -1;                }
 
-  // Differentiate at which edge we are.
-  if (iBeam >= 1 && iBeam <= g_tOpts.iSize) {
-    iX = 0;
-    iY = iBeam;
-    *piDirection = DIR_RIGHT;
-  }
-  if (iBeam >= g_tOpts.iSize + 1 && iBeam <= 2 * g_tOpts.iSize) {
-    iX = iBeam - g_tOpts.iSize;
-    iY = g_tOpts.iWidth - 1;
-    *piDirection = DIR_UP;
-  }
-  if (iBeam >= 2 * g_tOpts.iSize + 1 && iBeam <= 3 * g_tOpts.iSize) {
-    iX = g_tOpts.iWidth - 1;
-    iY = (3 * g_tOpts.iSize + 1) - iBeam;
-    *piDirection = DIR_LEFT;
-  }
-  if (iBeam >= 3 * g_tOpts.iSize + 1 && iBeam <= 4 * g_tOpts.iSize) {
-    iX = (4 * g_tOpts.iSize + 1) - iBeam;
-    iY = 0;
-    *piDirection = DIR_DOWN;
-  }
+  symmetricXY(iSym, iSize, iX, iY, &iX, &iY);
 
-  cellFromXY(piEntryCell, iX, iY);
+  // Node like getExitNode().
+  if (iX == -1) return iY + 1;
+  if (iY == n)  return iX + 1 + n;
+  if (iX == n)  return 3 * n - iY;
 
-  return csBeam;
+  return 4 * n - iX;
 }
 
 /*******************************************************************************
- * Name:  getExitNode
- * Purpose: Translate exit cell into beam's exit node number.
+ * Name:  compareProbe
+ * Purpose: Compares two probes by entry and exit for qsort().
  *******************************************************************************/
-int getExitNode(int iCell) {
-  int  iBeam = 0;
-  int  iX    = 0;
-  int  iY    = 0;
+int compareProbe(const void* pvA, const void* pvB) {
+  const t_probe* ptA = (const t_probe*) pvA;
+  const t_probe* ptB = (const t_probe*) pvB;
 
-  cellToXY(iCell, &iX, &iY);
+  if (ptA->iEntry != ptB->iEntry)
+    return (ptA->iEntry > ptB->iEntry) - (ptA->iEntry < ptB->iEntry);
 
-  // Determin on wich edge we are.
-  if (iX == 0)                  iBeam = iY;
-  if (iY == g_tOpts.iWidth - 1) iBeam = iX + g_tOpts.iSize;
-  if (iX == g_tOpts.iWidth - 1) iBeam = (3 * g_tOpts.iSize + 1) - iY;
-  if (iY == 0)                  iBeam = (4 * g_tOpts.iSize + 1) - iX;
-
-  return iBeam;
+  return (ptA->iExit > ptB->iExit) - (ptA->iExit < ptB->iExit);
 }
 
 /*******************************************************************************
- * Name:  lookAhead
- * Purpose: Look up content of cells ahead in walking direction.
+ * Name:  symmetricProbes
+ * Purpose: Maps the probes by a symmetry into patOut, sorted and each just
+ *          once. Beams walk back the way they came, so a probe exiting is put
+ *          with the lower node first. Returns the count of probes left.
  *******************************************************************************/
-int lookAhead(int iCell, int iDirection) {
-  int iFront      = 0;
-  int iFrontLeft  = 0;
-  int iFrontRight = 0;
-
-  //           UP 1
-  //            ^
-  //            |
-  // LEFT 2 <---+---> 4 RIGHT
-  //            |
-  //            V
-  //         DOWN 3
+int symmetricProbes(int iSym, int iSize, const t_probe* patIn, int iProbes, t_probe* patOut) {
+  int iOut = 0;
+  int iTmp = 0;
 
-  if (iDirection == DIR_UP) {
-    iFront      = g_paiGrid[iCell - g_tOpts.iWidth];
-    iFrontLeft  = g_paiGrid[iCell - g_tOpts.iWidth - 1];
-    iFrontRight = g_paiGrid[iCell - g_tOpts.iWidth + 1];
-  }
-  if (iDirection == DIR_LEFT) {
-    iFront      = g_paiGrid[iCell - 1];
-    iFrontLeft  = g_paiGrid[iCell - 1 + g_tOpts.iWidth];
-    iFrontRight = g_paiGrid[iCell - 1 - g_tOpts.iWidth];
-  }
-  if (iDirection == DIR_DOWN) {
-    iFront      = g_paiGrid[iCell + g_tOpts.iWidth];
-    iFrontLeft  = g_paiGrid[iCell + g_tOpts.iWidth + 1];
-    iFrontRight = g_paiGrid[iCell + g_tOpts.iWidth - 1];
-  }
-  if (iDirection == DIR_RIGHT) {
-    iFront      = g_paiGrid[iCell + 1];
-    iFrontLeft  = g_paiGrid[iCell + 1 - g_tOpts.iWidth];
-    iFrontRight = g_paiGrid[iCell + 1 + g_tOpts.iWidth];
+  for (int p = 0; p < iProbes; ++p) {
+    patOut[p].iEntry = symmetricEdge(iSym, iSize, patIn[p].iEntry);
+    patOut[p].iExit  = symmetricEdge(iSym, iSize, patIn[p].iExit);
+    if (patOut[p].iExit != 0 && patOut[p].iExit < patOut[p].iEntry) {
+      iTmp             = patOut[p].iEntry;
+      patOut[p].iEntry = patOut[p].iExit;
+      patOut[p].iExit  = iTmp;
+    }
   }
+  if (iProbes > 1)
+    qsort(patOut, (size_t) iProbes, sizeof(t_probe), compareProbe);
 
-  if (iFront      == CELL_ATOM) return ATOM_CENTER;
-  if (iFrontLeft  == CELL_ATOM) return ATOM_LEFT;
-  if (iFrontRight == CELL_ATOM) return ATOM_RIGHT;
+  for (int p = 0; p < iProbes; ++p)
+    if (iOut == 0 || compareProbe(&patOut[p], &patOut[iOut - 1]) != 0)
+      patOut[iOut++] = patOut[p];
 
-  return ATOM_NONE;
+  return iOut;
 }
 
 /*******************************************************************************
- * Name:  turnBeam
- * Purpose: Turn beam's direction according atoms and correct under-/overflows.
+ * Name:  canonicalGame
+ * Purpose: Takes the atoms as inner cells y * size + x and the probes and puts
+ *          them into paiCanon and patCanon, under the symmetry giving the least
+ *          lists, probes first. Atoms are sorted, probes like in
+ *          symmetricProbes(). So games equal but for rotations and mirrors,
+ *          the probes' order and beams fired twice or back get the same lists.
+ *          paiTmp and patTmp need room for all atoms and probes, too, each may
+ *          be NULL without any. piProbes is the count of probes, afterwards of
+ *          the canonical ones. Returns the symmetry taken.
  *******************************************************************************/
-int turnBeam(int iAtom, int iDirection) {
-  // Turn right.
-  if (iAtom == ATOM_LEFT)
-    if (--iDirection == 0)
-      iDirection = 4;
+int canonicalGame(int iSize, const int* paiCells, int iAtoms, const t_probe* patProbes, int* piProbes,
+                  int* paiCanon, t_probe* patCanon, int* paiTmp, t_probe* patTmp) {
+  int iSymRv = 0;
+  int iCmp   = 0;
+  int iOut   = 0;
+  int iX     = 0;
+  int iY     = 0;
+
+  for (int iSym = 0; iSym < SYM_COUNT; ++iSym) {
+    iOut = symmetricProbes(iSym, iSize, patProbes, *piProbes, patTmp);
+    for (int i = 0; i < iAtoms; ++i) {
+      symmetricXY(iSym, iSize, paiCells[i] % iSize, paiCells[i] / iSize, &iX, &iY);
+      paiTmp[i] = iY * iSize + iX;
+    }
+    if (iAtoms > 1)
+      qsort(paiTmp, (size_t) iAtoms, sizeof(int), compareInt);
+
+    // Lexicographically least lists win, each symmetry leaves as many probes.
+    iCmp = 0;
+    for (int p = 0; p < iOut && iCmp == 0 && iSym > 0; ++p)
+      iCmp = compareProbe(&patTmp[p], &patCanon[p]);
+    for (int i = 0; i < iAtoms && iCmp == 0 && iSym > 0; ++i)
+      iCmp = compareInt(&paiTmp[i], &paiCanon[i]);
+    if (iSym == 0 || iCmp < 0) {
+      if (iOut > 0)
+        memcpy(patCanon, patTmp, sizeof(t_probe) * (size_t) iOut);
+      if (iAtoms > 0)
+        memcpy(paiCanon, paiTmp, sizeof(int) * (size_t) iAtoms);
+      iSymRv = iSym;
+    }
+  }
 
-  // Turn left.
-  if (iAtom == ATOM_RIGHT)
-    if (++iDirection == 5)
-      iDirection = 1;
+  *piProbes = iOut;
 
-  return iDirection;
+  return iSymRv;
 }
 
 /*******************************************************************************
- * Name:  goAhead
- * Purpose: Go one cell in the walking direction.
+ * Name:  canonicalAtoms
+ * Purpose: Same as canonicalGame(), just for atoms. So boards equal but for
+ *          rotations and mirrors get the same list. Returns the symmetry taken.
  *******************************************************************************/
-int goAhead(int iCell, int iDirection) {
-  if (iDirection == DIR_UP)    return iCell - g_tOpts.iWidth;
-  if (iDirection == DIR_LEFT)  return iCell - 1;
-  if (iDirection == DIR_DOWN)  return iCell + g_tOpts.iWidth;
-  if (iDirection == DIR_RIGHT) return iCell + 1;
+int canonicalAtoms(int iSize, const int* paiCells, int iAtoms, int* paiCanon, int* paiTmp) {
+  int iProbes = 0;
 
-  return -1;
+  return canonicalGame(iSize, paiCells, iAtoms, NULL, &iProbes, paiCanon, NULL, paiTmp, NULL);
+}
+
+/*******************************************************************************
+ * Name:  createSymmetryCells
+ * Purpose: Returns the inner cell y * size + x of each inner cell under each
+ *          symmetry, SYM_COUNT rows of size * size cells. Caller frees it.
+ *******************************************************************************/
+int* createSymmetryCells(int iSize) {
+  int  iCells      = iSize * iSize;
+  int* paiSymCells = (int*) malloc(sizeof(int) * (size_t) (SYM_COUNT * iCells));
+  int  iX          = 0;
+  int  iY          = 0;
+
+  for (int iSym = 0; iSym < SYM_COUNT; ++iSym)
+    for (int iCell = 0; iCell < iCells; ++iCell) {
+      symmetricXY(iSym, iSize, iCell % iSize, iCell / iSize, &iX, &iY);
+      paiSymCells[iSym * iCells + iCell] = iY * iSize + iX;
+    }
+
+  return paiSymCells;
+}
+
+/*******************************************************************************
+ * Name:  symmetricAtoms
+ * Purpose: Maps inner cells by a row of createSymmetryCells() into paiOut,
+ *          ascending. Few atoms sort fastest by insertion.
+ *******************************************************************************/
+static inline void symmetricAtoms(const int* paiMap, const int* paiCells, int iAtoms, int* paiOut) {
+  int iCell = 0;
+  int j     = 0;
+
+  for (int i = 0; i < iAtoms; ++i) {
+    iCell = paiMap[paiCells[i]];
+    for (j = i; j > 0 && paiOut[j - 1] > iCell; --j)
+      paiOut[j] = paiOut[j - 1];
+    paiOut[j] = iCell;
+  }
+}
+
+/*******************************************************************************
+ * Name:  isCanonicalAtoms
+ * Purpose: Returns 1 if the ascending atoms are canonical, like canonicalAtoms()
+ *          would put them. Stops at the first image less than them.
+ *******************************************************************************/
+int isCanonicalAtoms(const int* paiSymCells, int iCells, const int* paiCells, int iAtoms, int* paiTmp) {
+  int iCmp = 0;
+
+  for (int iSym = 1; iSym < SYM_COUNT; ++iSym) {
+    symmetricAtoms(&paiSymCells[iSym * iCells], paiCells, iAtoms, paiTmp);
+    iCmp = 0;
+    for (int i = 0; i < iAtoms && iCmp == 0; ++i)
+      iCmp = compareInt(&paiTmp[i], &paiCells[i]);
+    if (iCmp < 0)
+      return 0;
+  }
+
+  return 1;
+}
+
+/*******************************************************************************
+ * Name:  hashAtoms
+ * Purpose: Returns a 64 bit hash of a board's size and its canonical atoms.
+ *******************************************************************************/
+uint64_t hashAtoms(int iSize, const int* paiCanon, int iAtoms) {
+  uint64_t ullHash = 0xcbf29ce484222325ULL ^ (uint64_t) iSize;
+
+  // FNV-1a over the cells, ...
+  for (int i = 0; i < iAtoms; ++i)
+    ullHash = (ullHash ^ (uint64_t) paiCanon[i]) * 0x100000001b3ULL;
+
+  // ... with splitmix64's finalizer to spread all bits.
+  ullHash = (ullHash ^ (ullHash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  ullHash = (ullHash ^ (ullHash >> 27)) * 0x94d049bb133111ebULL;
+
+  return ullHash ^ (ullHash >> 31);
+}
+
+/*******************************************************************************
+ * Name:  getInnerAtoms
+ * Purpose: Gets the board's atoms as inner cells y * size + x, counted from 0.
+ *          Returns count of atoms.
+ *******************************************************************************/
+int getInnerAtoms(t_board* ptBoard, int* paiCells) {
+  int iX = 0;
+  int iY = 0;
+
+  for (int i = 0; i < ptBoard->iAtomsSet; ++i) {
+    cellToXY(ptBoard, ptBoard->paiAtoms[i], &iX, &iY);
+    paiCells[i] = (iY - 1) * ptBoard->iSize + iX - 1;
+  }
+
+  return ptBoard->iAtomsSet;
+}
+
+/*******************************************************************************
+ * Name:  createSymmetryTable
+ * Purpose: Returns the node of each node under each symmetry, SYM_COUNT rows
+ *          of 4 * size + 1 nodes. Caller frees it.
+ *******************************************************************************/
+int* createSymmetryTable(int iSize) {
+  int  iNodes      = 4 * iSize + 1;
+  int* paiSymEdges = (int*) malloc(sizeof(int) * (size_t) (SYM_COUNT * iNodes));
+
+  for (int iSym = 0; iSym < SYM_COUNT; ++iSym)
+    for (int iEdge = 0; iEdge < iNodes; ++iEdge)
+      paiSymEdges[iSym * iNodes + iEdge] = symmetricEdge(iSym, iSize, iEdge);
+
+  return paiSymEdges;
+}
+
+/*******************************************************************************
+ * Name:  putText
+ * Purpose: Copies a text to pcOut without its '\0', returns the end.
+ *******************************************************************************/
+static inline char* putText(char* pcOut, const char* pcText) {
+  size_t sLen = strlen(pcText);
+
+  memcpy(pcOut, pcText, sLen);
+
+  return pcOut + sLen;
+}
+
+/*******************************************************************************
+ * Name:  putNumber
+ * Purpose: Writes a number right aligned to at least iWidth chars like "%*lld",
+ *          returns the end.
+ *******************************************************************************/
+static inline char* putNumber(char* pcOut, ll llValue, int iWidth) {
+  char     acDigits[21];
+  char*    pcDigit  = acDigits + sizeof(acDigits);
+  uint64_t ullValue = (llValue < 0) ? 0ULL - (uint64_t) llValue : (uint64_t) llValue;
+  int      iLen     = 0;
+
+  do {
+    *--pcDigit = (char) ('0' + ullValue % 10);
+    ullValue  /= 10;
+  } while (ullValue != 0);
+  if (llValue < 0)
+    *--pcDigit = '-';
+
+  iLen = (int) (acDigits + sizeof(acDigits) - pcDigit);
+  for (; iWidth > iLen; --iWidth)
+    *pcOut++ = ' ';
+  memcpy(pcOut, pcDigit, (size_t) iLen);
+
+  return pcOut + iLen;
+}
+
+/*******************************************************************************
+ * Name:  initMarks
+ * Purpose: Sets up the outcome of each edge of a board, none yet.
+ *******************************************************************************/
+void initMarks(t_marks* ptMarks, int iSize) {
+  ptMarks->iSize    = iSize;
+  ptMarks->iPairs   = 0;
+  ptMarks->paiMarks = (int*) calloc((size_t) (4 * iSize + 1), sizeof(int));
+}
+
+/*******************************************************************************
+ * Name:  freeMarks
+ * Purpose: Frees the outcome of each edge.
+ *******************************************************************************/
+void freeMarks(t_marks* ptMarks) {
+  free(ptMarks->paiMarks);
+  ptMarks->paiMarks = NULL;
+}
+
+/*******************************************************************************
+ * Name:  addMark
+ * Purpose: Marks the edges of a beam, 'iExit' 0 if absorbed. Each pair gets its
+ *          next label, a beam from an edge marked already tells nothing new.
+ *******************************************************************************/
+void addMark(t_marks* ptMarks, int iEntry, int iExit) {
+  if (ptMarks->paiMarks[iEntry] != MARK_NONE)
+    return;
+
+  if (iExit == 0)
+    ptMarks->paiMarks[iEntry] = MARK_ABSORBED;
+  else if (iExit == iEntry)
+    ptMarks->paiMarks[iEntry] = MARK_REFLECTED;
+  else
+    ptMarks->paiMarks[iEntry] = ptMarks->paiMarks[iExit] = ++ptMarks->iPairs;
+}
+
+/*******************************************************************************
+ * Name:  putMark
+ * Purpose: Writes an edge's mark right aligned to 3 chars, 'A' absorbed, 'R'
+ *          reflected, pairs 'a' to 'z', then 'aa' to 'zz' and so on. Returns
+ *          the end.
+ *******************************************************************************/
+static inline char* putMark(char* pcOut, int iMark) {
+  int iPair = iMark - 1;
+  int i     = 2;
+
+  memcpy(pcOut, "   ", 3);
+  if (iMark == MARK_ABSORBED)
+    pcOut[2] = 'A';
+  else if (iMark == MARK_REFLECTED)
+    pcOut[2] = 'R';
+  else if (iMark != MARK_NONE) {
+    do {
+      pcOut[i--] = (char) ('a' + iPair % 26);
+      iPair      = iPair / 26 - 1;
+    } while (iPair >= 0 && i >= 0);
+  }
+
+  return pcOut + 3;
+}
+
+/*******************************************************************************
+ * Name:  renderBoard
+ * Purpose: Appends the board with or without the solution to a cstr, with the
+ *          marks of the beams' outcomes around it, if any.
+ *******************************************************************************/
+void renderBoard(t_board* ptBoard, int bWithSolution, const t_marks* ptMarks, cstr* pcsOut) {
+  int         n        = ptBoard->iSize;
+  const int*  paiRow   = NULL;
+  const int*  paiMark  = (ptMarks != NULL) ? ptMarks->paiMarks : NULL;
+  const char* pcMargin = (ptMarks != NULL) ? MARK_MARGIN : "";
+  char*       pcStart  = NULL;
+  char*       pcOut    = NULL;
+  char*       pcRule   = NULL;
+  long long   llRule   = (long long) strlen(pcMargin) + 4 + 1 + 4 * (long long) n + 1;
+
+  //     16  15  14  13
+  //    +---+---+---+---+
+  //  1 |   |   |   |   | 12
+  //    +---+---+---+---+
+  //  2 |   |   | X |   | 11
+  //    +---+---+---+---+
+  //  3 |   |   |   |   | 10
+  //    +---+---+---+---+
+  //  4 |   | X | X |   |  9
+  //    +---+---+---+---+
+  //      5   6   7   8
+  //
+  // With marks, each line is shifted right by the margin and the marks go
+  // next to the numbers, top and bottom ones on a line of their own:
+  //
+  //                a   A
+  //         16  15  14  13
+  //        +---+---+---+---+
+  //  a   1 |   |   |   |   | 12
+  //  ...
+
+  // Room for all of it at once, numbers take at most 11 chars, marks 3.
+  pcStart = pcOut = csReserve(pcsOut, 64 + 4 * (8 + 12 * (long long) n + 2) +
+                                      (n + 1) * llRule + n * (8 + 12 + 1 + 4 * (long long) n + 12 + 5));
+
+  // Help text.
+  pcOut = putText(pcOut, "\n\n");
+  pcOut = putText(pcOut, pcMargin);
+  pcOut = putText(pcOut, "Atoms hidden = ");
+  pcOut = putNumber(pcOut, ptBoard->iAtomNo, 0);
+  pcOut = putText(pcOut, "\n");
+
+  // Top marks on the blank line.
+  if (paiMark != NULL) {
+    pcOut = putText(pcOut, MARK_MARGIN "    ");
+    for (int iX = 0; iX < n; ++iX) {
+      pcOut    = putMark(pcOut, paiMark[4 * n - iX]);
+      *pcOut++ = ' ';
+    }
+  }
+  pcOut = putText(pcOut, "\n");
+
+  // Top numbers.
+  pcOut = putText(pcOut, pcMargin);
+  pcOut = putText(pcOut, "    ");
+  for (int iX = 0; iX < n; ++iX) {
+    pcOut    = putNumber(pcOut, 4 * n - iX, 3);
+    *pcOut++ = ' ';
+  }
+  *pcOut++ = '\n';
+
+  // First horizontal line, the others are copies of it.
+  pcRule = pcOut;
+  pcOut  = putText(pcOut, pcMargin);
+  pcOut  = putText(pcOut, "    +");
+  for (int iX = 0; iX < n; ++iX)
+    pcOut = putText(pcOut, "---+");
+  *pcOut++ = '\n';
+
+  // Cells line plus horizontal line 'iSize' times.
+  for (int iY = 0; iY < n; ++iY) {
+    if (paiMark != NULL) {
+      pcOut    = putMark(pcOut, paiMark[iY + 1]);
+      *pcOut++ = ' ';
+    }
+    pcOut    = putNumber(pcOut, iY + 1, 3);
+    pcOut    = putText(pcOut, " |");
+    paiRow   = &ptBoard->paiGrid[(iY + 1) * ptBoard->iWidth + 1];
+    for (int iX = 0; iX < n; ++iX) {
+      memcpy(pcOut, "   |", 4);
+      if (bWithSolution == BOARD_SOLUTION && paiRow[iX] == CELL_ATOM)
+        pcOut[1] = 'X';
+      pcOut += 4;
+    }
+    pcOut    = putNumber(pcOut, 3 * n - iY, 3);
+    *pcOut++ = ' ';
+    if (paiMark != NULL)
+      pcOut = putMark(pcOut, paiMark[3 * n - iY]);
+    *pcOut++ = '\n';
+    memcpy(pcOut, pcRule, (size_t) llRule);
+    pcOut   += llRule;
+  }
+
+  // Bottom numbers.
+  pcOut = putText(pcOut, pcMargin);
+  pcOut = putText(pcOut, "    ");
+  for (int iX = 1; iX <= n; ++iX) {
+    pcOut    = putNumber(pcOut, n + iX, 3);
+    *pcOut++ = ' ';
+  }
+  *pcOut++ = '\n';
+
+  // Bottom marks on a line of their own.
+  if (paiMark != NULL) {
+    pcOut = putText(pcOut, MARK_MARGIN "    ");
+    for (int iX = 1; iX <= n; ++iX) {
+      pcOut    = putMark(pcOut, paiMark[n + iX]);
+      *pcOut++ = ' ';
+    }
+    *pcOut++ = '\n';
+  }
+  *pcOut++ = '\n';
+
+  csExtend(pcsOut, pcOut - pcStart);
+}
+
+/*******************************************************************************
+ * Name:  printBoard
+ * Purpose: Prints the board with or without the solution and the marks, if
+ *          any, with one write. Its buffer is kept for the next board.
+ *******************************************************************************/
+void printBoard(t_board* ptBoard, int bWithSolution, const t_marks* ptMarks) {
+  static cstr csOut = {0};
+
+  // Reuse the buffer, csReserve() sets it up the first time.
+  csReset(&csOut);
+  renderBoard(ptBoard, bWithSolution, ptMarks, &csOut);
+  fwrite(csOut.cStr, 1, (size_t) csOut.len, stdout);
+}
+
+/*******************************************************************************
+ * Name:  putCursor
+ * Purpose: Writes the ANSI escape moving the cursor to iRow and iCol, returns
+ *          the end.
+ *******************************************************************************/
+static inline char* putCursor(char* pcOut, int iRow, int iCol) {
+  pcOut    = putText(pcOut, "\x1b[");
+  pcOut    = putNumber(pcOut, iRow, 0);
+  *pcOut++ = ';';
+  pcOut    = putNumber(pcOut, iCol, 0);
+  *pcOut++ = 'H';
+
+  return pcOut;
+}
+
+/*******************************************************************************
+ * Name:  initTui
+ * Purpose: Sets up the terminal UI, returns 0 if stdout is no terminal or the
+ *          board doesn't fit into it.
+ *******************************************************************************/
+int initTui(t_tui* ptTui, int iSize) {
+  struct winsize tWin = {0};
+
+  ptTui->iSize      = iSize;
+  ptTui->iStatusRow = TUI_ROW_CELLS + 2 * iSize + 3;
+  ptTui->bDirty     = 0;
+  ptTui->csBoard    = csNew("");
+  ptTui->csOut      = csNew("");
+
+  if (!isatty(STDOUT_FILENO) || ioctl(STDOUT_FILENO, TIOCGWINSZ, &tWin) != 0)
+    return 0;
+
+  // Room for the status and the prompt below the board, right marks on the
+  // right.
+  return tWin.ws_row >= ptTui->iStatusRow + 1 &&
+         tWin.ws_col >= TUI_MARGIN + 4 * iSize + 12;
+}
+
+/*******************************************************************************
+ * Name:  freeTui
+ * Purpose: Frees the terminal UI's buffers.
+ *******************************************************************************/
+void freeTui(t_tui* ptTui) {
+  csFree(&ptTui->csBoard);
+  csFree(&ptTui->csOut);
+}
+
+/*******************************************************************************
+ * Name:  flushTui
+ * Purpose: Writes all escapes and marks of the terminal UI at once.
+ *******************************************************************************/
+void flushTui(t_tui* ptTui) {
+  fwrite(ptTui->csOut.cStr, 1, (size_t) ptTui->csOut.len, stdout);
+  fflush(stdout);
+
+  csReset(&ptTui->csOut);
+}
+
+/*******************************************************************************
+ * Name:  getMarkPos
+ * Purpose: Gets row and column of an edge's mark, right next to its number.
+ *******************************************************************************/
+void getMarkPos(t_tui* ptTui, int iEdge, int* piRow, int* piCol) {
+  int n = ptTui->iSize;
+
+  // Left marks are in the margin, top and bottom ones on the blank lines
+  // outside of the numbers.
+  if (iEdge <= n) {
+    *piRow = TUI_ROW_CELLS + 2 * (iEdge - 1);
+    *piCol = 1;
+  }
+  else if (iEdge <= 2 * n) {
+    *piRow = TUI_ROW_CELLS + 2 * n + 1;
+    *piCol = TUI_MARGIN + 4 * (iEdge - n - 1) + 5;
+  }
+  else if (iEdge <= 3 * n) {
+    *piRow = TUI_ROW_CELLS + 2 * (3 * n - iEdge);
+    *piCol = TUI_MARGIN + 4 * n + 10;
+  }
+  else {
+    *piRow = TUI_ROW_CELLS - 3;
+    *piCol = TUI_MARGIN + 4 * (4 * n - iEdge) + 5;
+  }
+}
+
+/*******************************************************************************
+ * Name:  markBeam
+ * Purpose: Draws the marks of a beam's edges, leaves the cursor on the status
+ *          row.
+ *******************************************************************************/
+void markBeam(t_tui* ptTui, const t_marks* ptMarks, int iEntry, int iExit) {
+  char* pcOut   = NULL;
+  char* pcStart = NULL;
+  int   iRow    = 0;
+  int   iCol    = 0;
+
+  pcStart = pcOut = csReserve(&ptTui->csOut, 3 * 32);
+
+  getMarkPos(ptTui, iEntry, &iRow, &iCol);
+  pcOut = putCursor(pcOut, iRow, iCol);
+  pcOut = putMark(pcOut, ptMarks->paiMarks[iEntry]);
+  if (iExit != 0 && iExit != iEntry) {
+    getMarkPos(ptTui, iExit, &iRow, &iCol);
+    pcOut = putCursor(pcOut, iRow, iCol);
+    pcOut = putMark(pcOut, ptMarks->paiMarks[iExit]);
+  }
+  pcOut = putCursor(pcOut, ptTui->iStatusRow, 1);
+
+  csExtend(&ptTui->csOut, pcOut - pcStart);
+}
+
+/*******************************************************************************
+ * Name:  drawTui
+ * Purpose: Clears the screen and draws the board with or without the solution
+ *          and the marks of all beams. Leaves the cursor on the status row.
+ *******************************************************************************/
+void drawTui(t_tui* ptTui, t_board* ptBoard, int bWithSolution, const t_marks* ptMarks) {
+  char* pcLine  = NULL;
+  char* pcEnd   = NULL;
+  char* pcOut   = NULL;
+  char* pcStart = NULL;
+  int   iRow    = 1;
+
+  csReset(&ptTui->csBoard);
+  renderBoard(ptBoard, bWithSolution, ptMarks, &ptTui->csBoard);
+
+  // Each line on its row, without the leading blank lines.
+  pcStart = pcOut = csReserve(&ptTui->csOut, ptTui->csBoard.len + 32 * (2 * (ll) ptTui->iSize + 10));
+  pcOut   = putText(pcOut, "\x1b[H\x1b[2J");
+  for (pcLine = ptTui->csBoard.cStr + 2; *pcLine != '\0'; pcLine = pcEnd + 1, ++iRow) {
+    pcEnd = strchr(pcLine, '\n');
+    if (pcEnd == pcLine)
+      continue;
+    pcOut = putCursor(pcOut, iRow, 1);
+    memcpy(pcOut, pcLine, (size_t) (pcEnd - pcLine));
+    pcOut += pcEnd - pcLine;
+  }
+  pcOut = putCursor(pcOut, ptTui->iStatusRow, 1);
+  csExtend(&ptTui->csOut, pcOut - pcStart);
+
+  ptTui->bDirty = 0;
+  flushTui(ptTui);
+}
+
+/*******************************************************************************
+ * Name:  clearStatus
+ * Purpose: Clears all below the board for the next outcome, draws the board
+ *          again first, if output might have scrolled it.
+ *******************************************************************************/
+void clearStatus(t_tui* ptTui, t_board* ptBoard, const t_marks* ptMarks) {
+  char* pcOut   = NULL;
+  char* pcStart = NULL;
+
+  if (ptTui->bDirty)
+    drawTui(ptTui, ptBoard, BOARD_NEUTRAL, ptMarks);
+
+  pcStart = pcOut = csReserve(&ptTui->csOut, 32);
+  pcOut   = putCursor(pcOut, ptTui->iStatusRow, 1);
+  pcOut   = putText(pcOut, "\x1b[J");
+  csExtend(&ptTui->csOut, pcOut - pcStart);
+
+  flushTui(ptTui);
+}
+
+/*******************************************************************************
+ * Name:  initEvents
+ * Purpose: Keeps stdout for the events alone, all the prose goes to stderr
+ *          from now on. CSV starts with its header.
+ *******************************************************************************/
+void initEvents(t_events* ptEv, int iFormat) {
+  struct stat tStat = {0};
+
+  ptEv->iFormat = iFormat;
+  ptEv->bSync   = fstat(STDIN_FILENO, &tStat) != 0 || !S_ISREG(tStat.st_mode);
+  ptEv->iCol    = 0;
+  ptEv->pcOut   = NULL;
+  ptEv->csOut   = csNew("");
+
+  fflush(stdout);
+  ptEv->iFd = dup(STDOUT_FILENO);
+  if (ptEv->iFd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0)
+    dispatchError(ERR_FILE, "Can't keep stdout for the events");
+
+  if (iFormat == FORMAT_CSV) {
+    csAppend(&ptEv->csOut, "event");
+    for (int i = 0; i < EV_COUNT; ++i) {
+      csAppend(&ptEv->csOut, ",");
+      csAppend(&ptEv->csOut, g_apcEvCols[i]);
+    }
+    csAppend(&ptEv->csOut, "\n");
+  }
+}
+
+/*******************************************************************************
+ * Name:  flushEvents
+ * Purpose: Writes all events buffered, the buffer is kept for the next ones.
+ *******************************************************************************/
+void flushEvents(t_events* ptEv) {
+  ll      llSent = 0;
+  ssize_t sSent  = 0;
+
+  if (ptEv->iFormat == FORMAT_TEXT)
+    return;
+
+  while (llSent < ptEv->csOut.len) {
+    sSent = write(ptEv->iFd, ptEv->csOut.cStr + llSent, (size_t) (ptEv->csOut.len - llSent));
+    if (sSent < 0)
+      break;
+    llSent += sSent;
+  }
+
+  csReset(&ptEv->csOut);
+}
+
+/*******************************************************************************
+ * Name:  syncEvents
+ * Purpose: Writes the events buffered, if the next input isn't there yet, so
+ *          whoever drives the game gets them prior answering.
+ *******************************************************************************/
+void syncEvents(t_events* ptEv) {
+  struct pollfd tPoll = {.fd = STDIN_FILENO, .events = POLLIN};
+
+  if (ptEv->iFormat != FORMAT_TEXT && ptEv->bSync && poll(&tPoll, 1, 0) == 0)
+    flushEvents(ptEv);
+}
+
+/*******************************************************************************
+ * Name:  freeEvents
+ * Purpose: Writes the events left and closes their stdout.
+ *******************************************************************************/
+void freeEvents(t_events* ptEv) {
+  flushEvents(ptEv);
+  close(ptEv->iFd);
+  csFree(&ptEv->csOut);
+}
+
+/*******************************************************************************
+ * Name:  startEvent
+ * Purpose: Starts an event, its fields follow in the order of EV_*.
+ *******************************************************************************/
+void startEvent(t_events* ptEv, const char* pcEvent) {
+  // Room for the whole event, it's committed by endEvent().
+  ptEv->pcOut = csReserve(&ptEv->csOut, EV_MAX_LEN);
+  ptEv->iCol  = 0;
+
+  if (ptEv->iFormat == FORMAT_JSON) {
+    ptEv->pcOut = putText(ptEv->pcOut, "{\"event\":\"");
+    ptEv->pcOut = putText(ptEv->pcOut, pcEvent);
+    *ptEv->pcOut++ = '"';
+  }
+  else
+    ptEv->pcOut = putText(ptEv->pcOut, pcEvent);
+}
+
+/*******************************************************************************
+ * Name:  putField
+ * Purpose: Starts field iCol of the event, CSV leaves the fields skipped empty.
+ *******************************************************************************/
+static inline void putField(t_events* ptEv, int iCol) {
+  if (ptEv->iFormat == FORMAT_JSON) {
+    ptEv->pcOut = putText(ptEv->pcOut, ",\"");
+    ptEv->pcOut = putText(ptEv->pcOut, g_apcEvCols[iCol]);
+    ptEv->pcOut = putText(ptEv->pcOut, "\":");
+  }
+  else {
+    for (; ptEv->iCol <= iCol; ++ptEv->iCol)
+      *ptEv->pcOut++ = ',';
+  }
+}
+
+/*******************************************************************************
+ * Name:  addNumber
+ * Purpose: Adds a number as field iCol to the event.
+ *******************************************************************************/
+void addNumber(t_events* ptEv, int iCol, ll llValue) {
+  putField(ptEv, iCol);
+  ptEv->pcOut = putNumber(ptEv->pcOut, llValue, 0);
+}
+
+/*******************************************************************************
+ * Name:  addText
+ * Purpose: Adds a text as field iCol to the event, it needs no escapes.
+ *******************************************************************************/
+void addText(t_events* ptEv, int iCol, const char* pcText) {
+  putField(ptEv, iCol);
+  if (ptEv->iFormat == FORMAT_JSON) {
+    *ptEv->pcOut++ = '"';
+    ptEv->pcOut    = putText(ptEv->pcOut, pcText);
+    *ptEv->pcOut++ = '"';
+  }
+  else
+    ptEv->pcOut = putText(ptEv->pcOut, pcText);
+}
+
+/*******************************************************************************
+ * Name:  addFlag
+ * Purpose: Adds a flag as field iCol to the event, true or false in JSON and
+ *          1 or 0 in CSV.
+ *******************************************************************************/
+void addFlag(t_events* ptEv, int iCol, int bFlag) {
+  putField(ptEv, iCol);
+  if (ptEv->iFormat == FORMAT_JSON)
+    ptEv->pcOut = putText(ptEv->pcOut, bFlag ? "true" : "false");
+  else
+    *ptEv->pcOut++ = bFlag ? '1' : '0';
+}
+
+/*******************************************************************************
+ * Name:  endEvent
+ * Purpose: Ends the event, it's written as soon as enough are buffered.
+ *******************************************************************************/
+void endEvent(t_events* ptEv) {
+  if (ptEv->iFormat == FORMAT_JSON)
+    *ptEv->pcOut++ = '}';
+  else
+    putField(ptEv, EV_COUNT - 1);
+  *ptEv->pcOut++ = '\n';
+
+  csExtend(&ptEv->csOut, ptEv->pcOut - (ptEv->csOut.cStr + ptEv->csOut.len));
+
+  if (ptEv->csOut.len >= EV_FLUSH)
+    flushEvents(ptEv);
+}
+
+/*******************************************************************************
+ * Name:  eventBoard
+ * Purpose: Adds the event of the board created.
+ *******************************************************************************/
+void eventBoard(t_events* ptEv, ll llSeed, int iSize, int iAtomNo) {
+  if (ptEv->iFormat == FORMAT_TEXT)
+    return;
+
+  startEvent(ptEv, "board");
+  addNumber(ptEv, EV_SEED, llSeed);
+  addNumber(ptEv, EV_SIZE, iSize);
+  addNumber(ptEv, EV_ATOMS, iAtomNo);
+  endEvent(ptEv);
+}
+
+/*******************************************************************************
+ * Name:  eventProbe
+ * Purpose: Adds the event of a beam fired, exit 0 if absorbed.
+ *******************************************************************************/
+void eventProbe(t_events* ptEv, int iEntry, int iExit) {
+  if (ptEv->iFormat == FORMAT_TEXT)
+    return;
+
+  startEvent(ptEv, "probe");
+  addNumber(ptEv, EV_ENTRY, iEntry);
+  addNumber(ptEv, EV_EXIT, iExit);
+  addText(ptEv, EV_OUTCOME, (iExit == 0) ? "absorbed" : (iExit == iEntry) ? "reflected" : "exited");
+  endEvent(ptEv);
+}
+
+/*******************************************************************************
+ * Name:  eventGuess
+ * Purpose: Adds the event of an atom guessed.
+ *******************************************************************************/
+void eventGuess(t_events* ptEv, int iY, int iX, int bHit) {
+  if (ptEv->iFormat == FORMAT_TEXT)
+    return;
+
+  startEvent(ptEv, "guess");
+  addNumber(ptEv, EV_Y, iY);
+  addNumber(ptEv, EV_X, iX);
+  addFlag(ptEv, EV_HIT, bHit);
+  endEvent(ptEv);
+}
+
+/*******************************************************************************
+ * Name:  eventScore
+ * Purpose: Adds the event of the final score, counts of each kind and total.
+ *******************************************************************************/
+void eventScore(t_events* ptEv, const t_rules* ptRules, const t_score* ptScore) {
+  if (ptEv->iFormat == FORMAT_TEXT)
+    return;
+
+  startEvent(ptEv, "score");
+  addNumber(ptEv, EV_MISSED, ptScore->iMissedAtoms);
+  addNumber(ptEv, EV_EXITED, ptScore->iExited);
+  addNumber(ptEv, EV_REFLECTED, ptScore->iReflected);
+  addNumber(ptEv, EV_ABSORBED, ptScore->iAbsorbed);
+  addNumber(ptEv, EV_TOTAL, scoreTotal(ptRules, ptScore));
+  endEvent(ptEv);
+}
+
+/*******************************************************************************
+ * Name:  getEdgeCell
+ * Purpose: Translate entry number (iBeam) into according edge cell (iX, iY).
+ *******************************************************************************/
+int getEdgeCell(t_board* ptBoard, int iBeam, int* piEntryCell, int* piDirection) {
+  int iX = 0;
+  int iY = 0;
+
+  // Security check.
+  if (iBeam < 1 || iBeam > 4 * ptBoard->iSize) {
+    *piEntryCell = -1;
+    return 0;
+  }
+
+  // Differentiate at which edge we are.
+  if (iBeam >= 1 && iBeam <= ptBoard->iSize) {
+    iX = 0;
+    iY = iBeam;
+    *piDirection = DIR_RIGHT;
+  }
+  if (iBeam >= ptBoard->iSize + 1 && iBeam <= 2 * ptBoard->iSize) {
+    iX = iBeam - ptBoard->iSize;
+    iY = ptBoard->iWidth - 1;
+    *piDirection = DIR_UP;
+  }
+  if (iBeam >= 2 * ptBoard->iSize + 1 && iBeam <= 3 * ptBoard->iSize) {
+    iX = ptBoard->iWidth - 1;
+    iY = (3 * ptBoard->iSize + 1) - iBeam;
+    *piDirection = DIR_LEFT;
+  }
+  if (iBeam >= 3 * ptBoard->iSize + 1 && iBeam <= 4 * ptBoard->iSize) {
+    iX = (4 * ptBoard->iSize + 1) - iBeam;
+    iY = 0;
+    *piDirection = DIR_DOWN;
+  }
+
+  cellFromXY(ptBoard, piEntryCell, iX, iY);
+
+  return 1;
+}
+
+/*******************************************************************************
+ * Name:  getEntryNode
+ * Purpose: Asks for the entry number (iBeam), which is 0 if out of bounds.
+ *******************************************************************************/
+cstr getEntryNode(int* piBeam) {
+  cstr csBeam = csNew("");
+
+  csInput("Enter beam 's entry number: ", &csBeam);
+  *piBeam = (int) cstr2ll(csBeam);
+
+  // Security check.
+  if (*piBeam < 1 || *piBeam > 4 * g_tOpts.iSize)
+    *piBeam = 0;
+
+  return csBeam;
+}
+
+/*******************************************************************************
+ * Name:  getExitNode
+ * Purpose: Translate exit cell into beam's exit node number.
+ *******************************************************************************/
+int getExitNode(t_board* ptBoard, int iCell) {
+  int  iBeam = 0;
+  int  iX    = 0;
+  int  iY    = 0;
+
+  cellToXY(ptBoard, iCell, &iX, &iY);
+
+  // Determin on wich edge we are.
+  if (iX == 0)                  iBeam = iY;
+  if (iY == ptBoard->iWidth - 1) iBeam = iX + ptBoard->iSize;
+  if (iX == ptBoard->iWidth - 1) iBeam = (3 * ptBoard->iSize + 1) - iY;
+  if (iY == 0)                  iBeam = (4 * ptBoard->iSize + 1) - iX;
+
+  return iBeam;
+}
+
+/*******************************************************************************
+ * Name:  lookAhead
+ * Purpose: Look up content of cells ahead in walking direction.
+ *******************************************************************************/
+int lookAhead(t_board* ptBoard, int iCell, int iDirection) {
+  const int* paiGrid = ptBoard->paiGrid;
+  int        iFront  = iCell  + ptBoard->aiAhead[iDirection];
+  int        iSide   = ptBoard->aiSide[iDirection];
+
+  //           UP 1
+  //            ^
+  //            |
+  // LEFT 2 <---+---> 4 RIGHT
+  //            |
+  //            V
+  //         DOWN 3
+
+  return g_aiSeen[(paiGrid[iFront]         == CELL_ATOM) << 2 |
+                  (paiGrid[iFront + iSide] == CELL_ATOM) << 1 |
+                  (paiGrid[iFront - iSide] == CELL_ATOM)];
+}
+
+/*******************************************************************************
+ * Name:  turnBeam
+ * Purpose: Turn beam's direction according atoms.
+ *******************************************************************************/
+int turnBeam(int iAtom, int iDirection) {
+  return g_aaiTurned[iAtom][iDirection];
+}
+
+/*******************************************************************************
+ * Name:  goAhead
+ * Purpose: Go one cell in the walking direction.
+ *******************************************************************************/
+int goAhead(t_board* ptBoard, int iCell, int iDirection) {
+  return iCell + ptBoard->aiAhead[iDirection];
 }
 
 /*******************************************************************************
  * Name:  walkGrid
  * Purpose: Walks the beam across the board.
  *******************************************************************************/
-int walkGrid(int iEntryNo, int iDirection) {
-  int iAtom = 0;
-  int iCell = iEntryNo;
+int walkGrid(t_board* ptBoard, int iEntryNo, int iDirection) {
+  int iAtom = 0;
+  int iCell = iEntryNo;
+
+  // Infinit loop, will stop via return;
+  while (1) {
+    iAtom = lookAhead(ptBoard, iCell, iDirection);
+
+    // Beam was absorbed by an atom, done!
+    if (iAtom == ATOM_CENTER) return 0;
+
+    // Turn as long as atoms are on front sides.
+    while (iAtom == ATOM_LEFT || iAtom == ATOM_RIGHT) {
+      iDirection =  turnBeam(iAtom, iDirection);
+      // Still at border? Done! Looking ahead could leave the grid here.
+      if (ptBoard->paiGrid[iCell] == CELL_BORDER) return iCell;
+      iAtom      = lookAhead(ptBoard, iCell, iDirection);
+    }
+
+    // A step ahead without an atom in the way.
+    iCell = goAhead(ptBoard, iCell, iDirection);
+
+    // At border again? Done!
+    if (ptBoard->paiGrid[iCell] == CELL_BORDER) return iCell;
+  }
+}
+
+/*******************************************************************************
+ * Name:  getBits3
+ * Purpose: Returns bits iPos - 1 (bit 0), iPos (bit 1) and iPos + 1 (bit 2) of
+ *          a bitmask line.
+ *******************************************************************************/
+static inline uint getBits3(const uint64_t* paullLine, int iPos) {
+  int      iBit  = iPos - 1;
+  int      iOff  = iBit % BITS_WORD;
+  uint64_t ullRv = paullLine[iBit / BITS_WORD] >> iOff;
+
+  // Three bits may span two words.
+  if (iOff > BITS_WORD - 3)
+    ullRv |= paullLine[iBit / BITS_WORD + 1] << (BITS_WORD - iOff);
+
+  return (uint) ullRv & 0x07;
+}
+
+/*******************************************************************************
+ * Name:  lookAheadBits
+ * Purpose: Same as lookAhead(), but with three bits of a row or column.
+ *******************************************************************************/
+int lookAheadBits(t_board* ptBoard, int iX, int iY, int iDirection) {
+  uint uiBits = 0;
+
+  // Bit 1 is always in front, bit 0 and 2 are left or right of it, depending
+  // on the direction the row or column is looked at.
+  if (iDirection == DIR_UP)    uiBits = getBits3(&ptBoard->paullRows[(iY - 1) * ptBoard->iWords], iX);
+  if (iDirection == DIR_LEFT)  uiBits = getBits3(&ptBoard->paullCols[(iX - 1) * ptBoard->iWords], iY);
+  if (iDirection == DIR_DOWN)  uiBits = getBits3(&ptBoard->paullRows[(iY + 1) * ptBoard->iWords], iX);
+  if (iDirection == DIR_RIGHT) uiBits = getBits3(&ptBoard->paullCols[(iX + 1) * ptBoard->iWords], iY);
+
+  if (uiBits == 0)   return ATOM_NONE;
+  if (uiBits & 0x02) return ATOM_CENTER;
+
+  // Lower bit is left for up and right, but right for down and left.
+  if (iDirection == DIR_UP || iDirection == DIR_RIGHT)
+    return (uiBits & 0x01) ? ATOM_LEFT : ATOM_RIGHT;
+
+  return (uiBits & 0x04) ? ATOM_LEFT : ATOM_RIGHT;
+}
+
+/*******************************************************************************
+ * Name:  walkBits
+ * Purpose: Same as walkGrid(), but on bitmasks and x, y coordinates.
+ *******************************************************************************/
+int walkBits(t_board* ptBoard, int iEntryNo, int iDirection) {
+  int iAtom = 0;
+  int iCell = 0;
+  int iLast = ptBoard->iWidth - 1;
+  int iX    = 0;
+  int iY    = 0;
+
+  cellToXY(ptBoard, iEntryNo, &iX, &iY);
+
+  // Infinit loop, will stop via return;
+  while (1) {
+    iAtom = lookAheadBits(ptBoard, iX, iY, iDirection);
+
+    // Beam was absorbed by an atom, done!
+    if (iAtom == ATOM_CENTER) return 0;
+
+    // Turn as long as atoms are on front sides.
+    while (iAtom == ATOM_LEFT || iAtom == ATOM_RIGHT) {
+      iDirection =    turnBeam(iAtom, iDirection);
+      // Still at border (which is the entry)? Done!
+      if (iX == 0 || iY == 0 || iX == iLast || iY == iLast) return iEntryNo;
+      iAtom      = lookAheadBits(ptBoard, iX, iY, iDirection);
+    }
+
+    // A step ahead without an atom in the way.
+    if (iDirection == DIR_UP)    --iY;
+    if (iDirection == DIR_LEFT)  --iX;
+    if (iDirection == DIR_DOWN)  ++iY;
+    if (iDirection == DIR_RIGHT) ++iX;
+
+    // At border again? Done!
+    if (iX == 0 || iY == 0 || iX == iLast || iY == iLast) {
+      cellFromXY(ptBoard, &iCell, iX, iY);
+      return iCell;
+    }
+  }
+}
+
+/*******************************************************************************
+ * Name:  walkBeamsAvx2
+ * Purpose: Same as walkGrids() for iBeams beams at once, LANES of them walk in
+ *          lockstep. Each step looks ahead in all lanes with gathers, then
+ *          absorbs, turns or goes ahead by masks. A lane done takes the next
+ *          beam, so all lanes stay busy till the last beams.
+ *******************************************************************************/
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+void walkBeamsAvx2(t_board* ptBoard, const int* paiGrids, int iGrids, const int* paiCells, const int* paiDirs,
+                   int* paiExits, int iBeams) {
+  const int* paiGrid = paiGrids;
+  int        w       = ptBoard->iWidth;
+  int        aiCell[LANES]  __attribute__((aligned(32)));
+  int        aiDir[LANES]   __attribute__((aligned(32)));
+  int        aiPhase[LANES] __attribute__((aligned(32)));  // 0 entered, 1 turned, 2 went ahead.
+  int        aiExit[LANES]  __attribute__((aligned(32)));
+  int        aiBeam[LANES];
+  int        iNext   = 0;
+  int        iBusy   = 0;
+  int        iDone   = 0;
+  __m256i    vCell, vDir, vPhase, vHere, vFront, vAhead, vSide, vLeft, vRight;
+  __m256i    vCenter, vAtLeft, vAtRight, vTurn, vAbsorb, vBorder, vArrived, vOut, vDone;
+
+  // Per direction the step ahead, the step to its left and the directions
+  // after turning right or left.
+  const __m256i vStep      = _mm256_load_si256((const __m256i*) ptBoard->aiAhead);
+  const __m256i vStepLeft  = _mm256_load_si256((const __m256i*) ptBoard->aiSide);
+  const __m256i vDirRight  = _mm256_load_si256((const __m256i*) g_aaiTurned[ATOM_LEFT]);
+  const __m256i vDirLeft   = _mm256_load_si256((const __m256i*) g_aaiTurned[ATOM_RIGHT]);
+  const __m256i vAtom      = _mm256_set1_epi32(CELL_ATOM);
+  const __m256i vEdge      = _mm256_set1_epi32(CELL_BORDER);
+  const __m256i vOne       = _mm256_set1_epi32(1);
+  const __m256i vTwo       = _mm256_set1_epi32(2);
+  const __m256i vFirst     = _mm256_setzero_si256();
+  const __m256i vLast      = _mm256_set1_epi32(iGrids * ptBoard->iCellNo - 1);
+
+  // Idle lanes stand on the first inner cell, so their gathers stay inside.
+  for (int l = 0; l < LANES; ++l) {
+    aiBeam[l] = -1;
+    aiCell[l] = w + 1;
+    aiDir[l]  = DIR_UP;
+    aiPhase[l] = 0;
+    if (iNext < iBeams) {
+      aiBeam[l] = iNext;
+      aiCell[l] = paiCells[iNext];
+      aiDir[l]  = paiDirs[iNext++];
+      ++iBusy;
+    }
+  }
+
+  while (iBusy > 0) {
+   iDone = 0;
+
+   // Both vectors are independent, so their gathers overlap.
+   for (int h = 0; h < LANES; h += 8) {
+    vCell  = _mm256_load_si256((const __m256i*) &aiCell[h]);
+    vDir   = _mm256_load_si256((const __m256i*) &aiDir[h]);
+    vPhase = _mm256_load_si256((const __m256i*) &aiPhase[h]);
+
+    // Cells here, ahead, ahead left and ahead right.
+    // A lane which just went onto the top or bottom border would look up to
+    // a row off its grid. Its look is dropped, so it's just clamped into all
+    // grids, the next grid's row is as good.
+    vAhead = _mm256_add_epi32(vCell, _mm256_permutevar8x32_epi32(vStep, vDir));
+    vSide  = _mm256_permutevar8x32_epi32(vStepLeft, vDir);
+    vLeft  = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(vAhead, vSide), vFirst), vLast);
+    vRight = _mm256_min_epi32(_mm256_max_epi32(_mm256_sub_epi32(vAhead, vSide), vFirst), vLast);
+    vFront = _mm256_min_epi32(_mm256_max_epi32(vAhead, vFirst), vLast);
+    vHere  = _mm256_i32gather_epi32(paiGrid, vCell, 4);
+    vFront = _mm256_i32gather_epi32(paiGrid, vFront, 4);
+    vLeft  = _mm256_i32gather_epi32(paiGrid, vLeft, 4);
+    vRight = _mm256_i32gather_epi32(paiGrid, vRight, 4);
+
+    // Like lookAhead(), an atom ahead wins over one ahead left, which wins
+    // over one ahead right.
+    vCenter  = _mm256_cmpeq_epi32(vFront, vAtom);
+    vAtLeft  = _mm256_andnot_si256(vCenter, _mm256_cmpeq_epi32(vLeft, vAtom));
+    vAtRight = _mm256_andnot_si256(_mm256_or_si256(vCenter, vAtLeft), _mm256_cmpeq_epi32(vRight, vAtom));
+    vTurn    = _mm256_or_si256(vAtLeft, vAtRight);
+    vBorder  = _mm256_cmpeq_epi32(vHere, vEdge);
+
+    // Went ahead onto the border, done. An atom ahead absorbs, unless the beam
+    // just turned. Turning at the border is done, too.
+    vArrived = _mm256_and_si256(_mm256_cmpeq_epi32(vPhase, vTwo), vBorder);
+    vAbsorb  = _mm256_andnot_si256(vArrived, _mm256_andnot_si256(_mm256_cmpeq_epi32(vPhase, vOne), vCenter));
+    vDone    = _mm256_or_si256(_mm256_or_si256(vArrived, vAbsorb),
+                               _mm256_andnot_si256(vArrived, _mm256_and_si256(vTurn, vBorder)));
+    vOut     = _mm256_andnot_si256(vAbsorb, vCell);
+
+    // Turn right on an atom ahead left, left on one ahead right, else go ahead.
+    vDir   = _mm256_blendv_epi8(vDir, _mm256_permutevar8x32_epi32(vDirRight, vDir), vAtLeft);
+    vDir   = _mm256_blendv_epi8(vDir, _mm256_permutevar8x32_epi32(vDirLeft,  vDir), vAtRight);
+    vCell  = _mm256_blendv_epi8(vAhead, vCell, vTurn);
+    vPhase = _mm256_blendv_epi8(vTwo, vOne, vTurn);
+
+    _mm256_store_si256((__m256i*) &aiCell[h],  vCell);
+    _mm256_store_si256((__m256i*) &aiDir[h],   vDir);
+    _mm256_store_si256((__m256i*) &aiPhase[h], vPhase);
+    _mm256_store_si256((__m256i*) &aiExit[h],  vOut);
+    iDone |= _mm256_movemask_ps(_mm256_castsi256_ps(vDone)) << h;
+   }
+
+    // Idle lanes went a step, too.
+    if (iBusy < LANES)
+      for (int l = 0; l < LANES; ++l)
+        if (aiBeam[l] < 0) {
+          aiCell[l]  = w + 1;
+          aiDir[l]   = DIR_UP;
+          aiPhase[l] = 0;
+        }
+
+    // Lanes done hand in their exits and take the next beams.
+    while (iDone != 0) {
+      int l = __builtin_ctz((uint) iDone);
+      iDone &= iDone - 1;
+      if (aiBeam[l] < 0)
+        continue;
+
+      paiExits[aiBeam[l]] = aiExit[l];
+      aiBeam[l]  = -1;
+      aiCell[l]  = w + 1;
+      aiDir[l]   = DIR_UP;
+      aiPhase[l] = 0;
+      --iBusy;
+      if (iNext < iBeams) {
+        aiBeam[l] = iNext;
+        aiCell[l] = paiCells[iNext];
+        aiDir[l]  = paiDirs[iNext++];
+        ++iBusy;
+      }
+    }
+  }
+}
+#endif
+
+/*******************************************************************************
+ * Name:  walkGrids
+ * Purpose: Walks iBeams beams like walkGrid() on iGrids grids of the board's
+ *          size one after the other. Cells are offsets into all grids, so each
+ *          beam walks on the grid its entry cell is in. In lockstep with AVX2
+ *          if the CPU has it, else one by one.
+ *******************************************************************************/
+void walkGrids(t_board* ptBoard, const int* paiGrids, int iGrids, const int* paiCells, const int* paiDirs,
+               int* paiExits, int iBeams) {
+  t_board tGrids = *ptBoard;
+
+#if defined(__x86_64__) || defined(__i386__)
+  if (__builtin_cpu_supports("avx2")) {
+    walkBeamsAvx2(ptBoard, paiGrids, iGrids, paiCells, paiDirs, paiExits, iBeams);
+    return;
+  }
+#endif
+
+  // A beam never leaves its grid, so the steps are the same on all of them.
+  tGrids.paiGrid = (int*) paiGrids;
+  for (int i = 0; i < iBeams; ++i)
+    paiExits[i] = walkGrid(&tGrids, paiCells[i], paiDirs[i]);
+}
+
+/*******************************************************************************
+ * Name:  walkBeams
+ * Purpose: Walks iBeams beams like walkGrid() on the board's grid, see
+ *          walkGrids().
+ *******************************************************************************/
+void walkBeams(t_board* ptBoard, const int* paiCells, const int* paiDirs, int* paiExits, int iBeams) {
+  walkGrids(ptBoard, ptBoard->paiGrid, 1, paiCells, paiDirs, paiExits, iBeams);
+}
+
+/*******************************************************************************
+ * Name:  batchGrids
+ * Purpose: Returns how many grids of the board's size are walked at once.
+ *******************************************************************************/
+static inline int batchGrids(t_board* ptBoard) {
+  int iGrids = GRIDS_MAX_CELLS / ptBoard->iCellNo;
+
+  if (iGrids > GRIDS_BATCH) return GRIDS_BATCH;
+  if (iGrids < 1)           return 1;
+
+  return iGrids;
+}
+
+/*******************************************************************************
+ * Name:  createGrids
+ * Purpose: Returns iGrids copies of the board's grid one after the other, for
+ *          walkGrids(). Caller frees it.
+ *******************************************************************************/
+int* createGrids(t_board* ptBoard, int iGrids) {
+  size_t sCells   = (size_t) ptBoard->iCellNo;
+  int*   paiGrids = (int*) malloc(sizeof(int) * sCells * (size_t) iGrids);
+
+  for (int g = 0; g < iGrids; ++g)
+    memcpy(&paiGrids[(size_t) g * sCells], ptBoard->paiGrid, sizeof(int) * sCells);
+
+  return paiGrids;
+}
+
+/*******************************************************************************
+ * Name:  createExitTable
+ * Purpose: Walks every beam once, so the game only has to look up the exits.
+ *******************************************************************************/
+void createExitTable(t_board* ptBoard) {
+  int iCellEntry = 0;
+  int iCellExit  = 0;
+  int iDirection = 0;
+  int iBeams     = 4 * ptBoard->iSize;
+
+  // On large grids all beams walk at once.
+  if (!ptBoard->bBitboard && ptBoard->iSize >= LANES_MIN_SIZE) {
+    for (int iBeam = 1; iBeam <= iBeams; ++iBeam)
+      getEdgeCell(ptBoard, iBeam, &ptBoard->paiEntries[iBeam], &ptBoard->paiDirs[iBeam]);
+    walkBeams(ptBoard, &ptBoard->paiEntries[1], &ptBoard->paiDirs[1], &ptBoard->paiOuts[1], iBeams);
+    for (int iBeam = 1; iBeam <= iBeams; ++iBeam)
+      ptBoard->paiExits[iBeam] = (ptBoard->paiOuts[iBeam] == 0) ? 0 : getExitNode(ptBoard, ptBoard->paiOuts[iBeam]);
+    return;
+  }
+
+  // The board won't change after createBoard(), so neither will the beams.
+  for (int iBeam = 1; iBeam <= iBeams; ++iBeam) {
+    getEdgeCell(ptBoard, iBeam, &iCellEntry, &iDirection);
+    if (ptBoard->bBitboard)
+      iCellExit = walkBits(ptBoard, iCellEntry, iDirection);
+    else
+      iCellExit = walkGrid(ptBoard, iCellEntry, iDirection);
+
+    // Absorbed beams exit nowhere.
+    if (iCellExit == 0)
+      ptBoard->paiExits[iBeam] = 0;
+    else
+      ptBoard->paiExits[iBeam] = getExitNode(ptBoard, iCellExit);
+  }
+}
+
+/*******************************************************************************
+ * Name:  compareU64
+ * Purpose: Compares two uint64_t for qsort().
+ *******************************************************************************/
+int compareU64(const void* pvA, const void* pvB) {
+  uint64_t ullA = *(const uint64_t*) pvA;
+  uint64_t ullB = *(const uint64_t*) pvB;
+
+  return (ullA > ullB) - (ullA < ullB);
+}
+
+/*******************************************************************************
+ * Name:  initSparse
+ * Purpose: Sets up a sparse board, its memory grows with the atoms only.
+ *******************************************************************************/
+void initSparse(t_sparse* ptSp, int iSize, int iAtomNo) {
+  ptSp->iSize     = iSize;
+  ptSp->iAtomNo   = iAtomNo;
+  ptSp->iAtomsSet = 0;
+  ptSp->paullRows = (uint64_t*) realloc(ptSp->paullRows, sizeof(uint64_t) * (size_t) (iAtomNo + 1));
+  ptSp->paullCols = (uint64_t*) realloc(ptSp->paullCols, sizeof(uint64_t) * (size_t) (iAtomNo + 1));
+}
+
+/*******************************************************************************
+ * Name:  freeSparse
+ * Purpose: Frees sparse board's memory.
+ *******************************************************************************/
+void freeSparse(t_sparse* ptSp) {
+  free(ptSp->paullRows);
+  free(ptSp->paullCols);
+  memset(ptSp, 0, sizeof(t_sparse));
+}
+
+/*******************************************************************************
+ * Name:  createSparse
+ * Purpose: Sets new atoms into the sparse board. Cells are drawn at random and
+ *          drawn again if taken, so it needs most cells to be empty.
+ *******************************************************************************/
+void createSparse(t_sparse* ptSp, t_rand* ptRand) {
+  int iSet = 0;
+
+  ptSp->iAtomsSet = 0;
+
+  while (ptSp->iAtomsSet < ptSp->iAtomNo) {
+    for (int i = ptSp->iAtomsSet; i < ptSp->iAtomNo; ++i)
+      ptSp->paullRows[i] = (randBelow(ptRand, (uint64_t) ptSp->iSize) + 1) << 32 |
+                           (randBelow(ptRand, (uint64_t) ptSp->iSize) + 1);
+
+    // Drop cells drawn twice, they are drawn again.
+    qsort(ptSp->paullRows, (size_t) ptSp->iAtomNo, sizeof(uint64_t), compareU64);
+    iSet = (ptSp->iAtomNo > 0) ? 1 : 0;
+    for (int i = 1; i < ptSp->iAtomNo; ++i)
+      if (ptSp->paullRows[i] != ptSp->paullRows[iSet - 1])
+        ptSp->paullRows[iSet++] = ptSp->paullRows[i];
+    ptSp->iAtomsSet = iSet;
+  }
+
+  for (int i = 0; i < ptSp->iAtomNo; ++i)
+    ptSp->paullCols[i] = (ptSp->paullRows[i] & 0xffffffffULL) << 32 | ptSp->paullRows[i] >> 32;
+  qsort(ptSp->paullCols, (size_t) ptSp->iAtomNo, sizeof(uint64_t), compareU64);
+}
+
+/*******************************************************************************
+ * Name:  findKey
+ * Purpose: Returns the index of the first key not less than ullKey.
+ *******************************************************************************/
+static inline int findKey(const uint64_t* paullKeys, int iKeys, uint64_t ullKey) {
+  int iLow  = 0;
+  int iHigh = iKeys;
+  int iMid  = 0;
+
+  while (iLow < iHigh) {
+    iMid = iLow + (iHigh - iLow) / 2;
+    if (paullKeys[iMid] < ullKey)
+      iLow  = iMid + 1;
+    else
+      iHigh = iMid;
+  }
+
+  return iLow;
+}
+
+/*******************************************************************************
+ * Name:  isSparseAtom
+ * Purpose: Returns 1 if cell (x, y) of the sparse board holds an atom.
+ *******************************************************************************/
+static inline int isSparseAtom(t_sparse* ptSp, int iX, int iY) {
+  uint64_t ullKey = (uint64_t) iY << 32 | (uint64_t) iX;
+  int      i      = findKey(ptSp->paullRows, ptSp->iAtomsSet, ullKey);
+
+  return i < ptSp->iAtomsSet && ptSp->paullRows[i] == ullKey;
+}
+
+/*******************************************************************************
+ * Name:  nextInLine
+ * Purpose: Returns the position of the first atom in line iLine from iPos on
+ *          in direction iStep (1 or -1), or -1 if there is none.
+ *******************************************************************************/
+static inline ll nextInLine(const uint64_t* paullLines, int iAtoms, int iLine, int iPos, int iStep) {
+  uint64_t ullKey = (uint64_t) iLine << 32 | (uint64_t) iPos;
+  int      i      = findKey(paullLines, iAtoms, ullKey);
+
+  // Not less than the key forward, else the one before, if not equal.
+  if (iStep < 0 && !(i < iAtoms && paullLines[i] == ullKey))
+    --i;
+  if (i < 0 || i >= iAtoms || (paullLines[i] >> 32) != (uint64_t) iLine)
+    return -1;
+
+  return (ll) (paullLines[i] & 0xffffffffULL);
+}
+
+/*******************************************************************************
+ * Name:  lookAheadSparse
+ * Purpose: Same as lookAhead(), but on the sparse board.
+ *******************************************************************************/
+int lookAheadSparse(t_sparse* ptSp, int iX, int iY, int iDirection) {
+  int iSide = iDirection % 4 + 1;
+  int iFX   = iX + g_aiStepX[iDirection];
+  int iFY   = iY + g_aiStepY[iDirection];
+
+  return g_aiSeen[isSparseAtom(ptSp, iFX, iFY) << 2 |
+                  isSparseAtom(ptSp, iFX + g_aiStepX[iSide], iFY + g_aiStepY[iSide]) << 1 |
+                  isSparseAtom(ptSp, iFX - g_aiStepX[iSide], iFY - g_aiStepY[iSide])];
+}
+
+/*******************************************************************************
+ * Name:  walkSparse
+ * Purpose: Same as walkGrid(), but on the sparse board and from beam to exit
+ *          node, 0 if absorbed. Between looks ahead it jumps to the cell just
+ *          before the next atom in its own line or the two beside.
+ *******************************************************************************/
+int walkSparse(t_sparse* ptSp, int iBeam) {
+  int  n          = ptSp->iSize;
+  int  iX         = 0;
+  int  iY         = 0;
+  int  iDirection = 0;
+  int  iAtom      = 0;
+  int  iStep      = 0;
+  int  iPos       = 0;
+  int  iLine      = 0;
+  ll   llNext     = 0;
+  ll   llAtom     = 0;
+  int  bRow       = 0;
+
+  // Entry cell like getEdgeCell().
+  if      (iBeam <= n)     { iX = 0;                 iY = iBeam;             iDirection = DIR_RIGHT; }
+  else if (iBeam <= 2 * n) { iX = iBeam - n;         iY = n + 1;             iDirection = DIR_UP;    }
+  else if (iBeam <= 3 * n) { iX = n + 1;             iY = 3 * n + 1 - iBeam; iDirection = DIR_LEFT;  }
+  else                     { iX = 4 * n + 1 - iBeam; iY = 0;                 iDirection = DIR_DOWN;  }
+
+  while (1) {
+    iAtom = lookAheadSparse(ptSp, iX, iY, iDirection);
+
+    if (iAtom == ATOM_CENTER) return 0;
+
+    while (iAtom == ATOM_LEFT || iAtom == ATOM_RIGHT) {
+      iDirection = turnBeam(iAtom, iDirection);
+      if (iX == 0 || iY == 0 || iX == n + 1 || iY == n + 1) return iBeam;
+      iAtom      = lookAheadSparse(ptSp, iX, iY, iDirection);
+    }
+
+    // One step like walkGrid(), even into an atom seen just after turning.
+    iX += g_aiStepX[iDirection];
+    iY += g_aiStepY[iDirection];
+    if (iX == 0 || iY == 0 || iX == n + 1 || iY == n + 1)
+      break;
+
+    // Nothing to see till the cell before the nearest atom ahead in the lines
+    // looked at, or till the border.
+    bRow  = (g_aiStepX[iDirection] != 0);
+    iStep = bRow ? g_aiStepX[iDirection] : g_aiStepY[iDirection];
+    iPos  = bRow ? iX : iY;
+    iLine = bRow ? iY : iX;
+
+    llNext = (iStep > 0) ? n + 1 : 0;
+    for (int l = iLine - 1; l <= iLine + 1; ++l) {
+      llAtom = nextInLine(bRow ? ptSp->paullRows : ptSp->paullCols, ptSp->iAtomsSet, l, iPos + iStep, iStep);
+      if (llAtom >= 0 && ((iStep > 0) ? llAtom - 1 < llNext : llAtom + 1 > llNext))
+        llNext = llAtom - iStep;
+    }
+
+    if (bRow) iX = (int) llNext;
+    else      iY = (int) llNext;
+    if (iX == 0 || iY == 0 || iX == n + 1 || iY == n + 1)
+      break;
+  }
+
+  // Exit node like getExitNode().
+  if (iX == 0)     return iY;
+  if (iY == n + 1) return iX + n;
+  if (iX == n + 1) return 3 * n + 1 - iY;
+
+  return 4 * n + 1 - iX;
+}
+
+/*******************************************************************************
+ * Name:  walkPath
+ * Purpose: Same as walkGrid(), but keeps each cell the beam stood on in path.
+ *******************************************************************************/
+int walkPath(t_board* ptBoard, int iEntryNo, int iDirection, t_array(int)* ptPath) {
+  int iAtom = 0;
+  int iCell = iEntryNo;
+
+  ptPath->sCount = 0;
+  daAdd(int, (*ptPath), iCell);
+
+  while (1) {
+    iAtom = lookAhead(ptBoard, iCell, iDirection);
+
+    if (iAtom == ATOM_CENTER) return 0;
+
+    while (iAtom == ATOM_LEFT || iAtom == ATOM_RIGHT) {
+      iDirection = turnBeam(iAtom, iDirection);
+      if (ptBoard->paiGrid[iCell] == CELL_BORDER) return iCell;
+      iAtom      = lookAhead(ptBoard, iCell, iDirection);
+    }
+
+    iCell = goAhead(ptBoard, iCell, iDirection);
+    daAdd(int, (*ptPath), iCell);
+
+    if (ptBoard->paiGrid[iCell] == CELL_BORDER) return iCell;
+  }
+}
+
+/*******************************************************************************
+ * Name:  initBeamCache
+ * Purpose: Sets up the cache for the board, all beams stale.
+ *******************************************************************************/
+void initBeamCache(t_beamCache* ptCache, t_board* ptBoard) {
+  ptCache->iBeams     = 4 * ptBoard->iSize;
+  ptCache->iWords     = (ptCache->iBeams + 1 + BITS_WORD - 1) / BITS_WORD;
+  ptCache->paullOn    = (uint64_t*) calloc((size_t) (ptBoard->iCellNo * ptCache->iWords), sizeof(uint64_t));
+  ptCache->paullStale = (uint64_t*) calloc((size_t) ptCache->iWords, sizeof(uint64_t));
+  ptCache->patPaths   = calloc((size_t) ptCache->iBeams + 1, sizeof(t_array(int)));
+
+  for (int iBeam = 1; iBeam <= ptCache->iBeams; ++iBeam) {
+    daInit(int, ptCache->patPaths[iBeam]);
+    ptCache->patPaths[iBeam].sCount = 0;
+    ptCache->paullStale[iBeam / BITS_WORD] |= 1ULL << (iBeam % BITS_WORD);
+  }
+}
+
+/*******************************************************************************
+ * Name:  freeBeamCache
+ * Purpose: Frees cache's memory.
+ *******************************************************************************/
+void freeBeamCache(t_beamCache* ptCache) {
+  for (int iBeam = 1; iBeam <= ptCache->iBeams; ++iBeam)
+    daFree(ptCache->patPaths[iBeam]);
+  free(ptCache->patPaths);
+  free(ptCache->paullOn);
+  free(ptCache->paullStale);
+  memset(ptCache, 0, sizeof(t_beamCache));
+}
+
+/*******************************************************************************
+ * Name:  setCachedAtom
+ * Purpose: Sets or removes an atom like setAtom() and stales the beams which
+ *          stood on the cell or next to it.
+ *******************************************************************************/
+void setCachedAtom(t_beamCache* ptCache, t_board* ptBoard, int iCell, int bAtom) {
+  uint64_t* paullOn = NULL;
+
+  if ((ptBoard->paiGrid[iCell] == CELL_ATOM) == (bAtom != 0))
+    return;
+
+  setAtom(ptBoard, iCell, bAtom);
+
+  // Inner cells have all eight neighbours in the grid.
+  for (int iY = -1; iY <= 1; ++iY)
+    for (int iX = -1; iX <= 1; ++iX) {
+      paullOn = &ptCache->paullOn[(iCell + iY * ptBoard->iWidth + iX) * ptCache->iWords];
+      for (int w = 0; w < ptCache->iWords; ++w)
+        ptCache->paullStale[w] |= paullOn[w];
+    }
+}
+
+/*******************************************************************************
+ * Name:  updateExitTable
+ * Purpose: Same as createExitTable(), but walks the stale beams only.
+ *******************************************************************************/
+void updateExitTable(t_beamCache* ptCache, t_board* ptBoard) {
+  t_array(int)* ptPath     = NULL;
+  uint64_t      ullStale   = 0;
+  uint64_t      ullBit     = 0;
+  int           iBeam      = 0;
+  int           iCellEntry = 0;
+  int           iCellExit  = 0;
+  int           iDirection = 0;
+
+  for (int w = 0; w < ptCache->iWords; ++w) {
+    ullStale = ptCache->paullStale[w];
+    ptCache->paullStale[w] = 0;
+
+    while (ullStale != 0) {
+      iBeam     = w * BITS_WORD + __builtin_ctzll(ullStale);
+      ullBit    = 1ULL << (iBeam % BITS_WORD);
+      ullStale &= ullStale - 1;
+      ptPath    = &ptCache->patPaths[iBeam];
+
+      // Off the cells of the old walk, ...
+      for (size_t i = 0; i < ptPath->sCount; ++i)
+        ptCache->paullOn[ptPath->pVal[i] * ptCache->iWords + w] &= ~ullBit;
+
+      // ... and onto the cells of the new one.
+      getEdgeCell(ptBoard, iBeam, &iCellEntry, &iDirection);
+      iCellExit = walkPath(ptBoard, iCellEntry, iDirection, ptPath);
+      for (size_t i = 0; i < ptPath->sCount; ++i)
+        ptCache->paullOn[ptPath->pVal[i] * ptCache->iWords + w] |= ullBit;
+
+      ptBoard->paiExits[iBeam] = (iCellExit == 0) ? 0 : getExitNode(ptBoard, iCellExit);
+    }
+  }
+}
+
+/*******************************************************************************
+ * Name:  lookAheadOpen
+ * Purpose: Same as lookAhead(), but a cell the solver hasn't decided yet makes
+ *          the outcome open and is returned in piOpen. Without paiDecided all
+ *          cells are decided.
+ *******************************************************************************/
+int lookAheadOpen(t_board* ptBoard, int iCell, int iDirection, char* pacDecided, int* piOpen) {
+  int aiAhead[3] = {0};  // Front, front left and front right cell.
+
+  aiAhead[0] = iCell + ptBoard->aiAhead[iDirection];
+  aiAhead[1] = aiAhead[0] + ptBoard->aiSide[iDirection];
+  aiAhead[2] = aiAhead[0] - ptBoard->aiSide[iDirection];
+
+  // Same order as lookAhead(), an atom found first wins over an open cell.
+  for (int i = 0; i < 3; ++i) {
+    if (pacDecided != NULL && !pacDecided[aiAhead[i]]) {
+      *piOpen = aiAhead[i];
+      return ATOM_OPEN;
+    }
+    if (ptBoard->paiGrid[aiAhead[i]] == CELL_ATOM)
+      return (i == 0) ? ATOM_CENTER : (i == 1) ? ATOM_LEFT : ATOM_RIGHT;
+  }
+
+  return ATOM_NONE;
+}
+
+/*******************************************************************************
+ * Name:  walkOpen
+ * Purpose: Same as walkGrid(), but returns WALK_OPEN if the beam gets near a
+ *          cell not decided by the solver yet.
+ *******************************************************************************/
+int walkOpen(t_board* ptBoard, int iEntryNo, int iDirection, char* pacDecided, int* piOpen) {
+  int iAtom = 0;
+  int iCell = iEntryNo;
+
+  while (1) {
+    iAtom = lookAheadOpen(ptBoard, iCell, iDirection, pacDecided, piOpen);
+
+    if (iAtom == ATOM_OPEN)   return WALK_OPEN;
+    if (iAtom == ATOM_CENTER) return 0;
+
+    while (iAtom == ATOM_LEFT || iAtom == ATOM_RIGHT) {
+      iDirection = turnBeam(iAtom, iDirection);
+      if (ptBoard->paiGrid[iCell] == CELL_BORDER) return iCell;
+      iAtom      = lookAheadOpen(ptBoard, iCell, iDirection, pacDecided, piOpen);
+      if (iAtom == ATOM_OPEN) return WALK_OPEN;
+    }
+
+    iCell = goAhead(ptBoard, iCell, iDirection);
+
+    if (ptBoard->paiGrid[iCell] == CELL_BORDER) return iCell;
+  }
+}
+
+/*******************************************************************************
+ * Name:  walkSeen
+ * Purpose: Same as walkGrid(), cells not decided are empty. Each of them looked
+ *          at gets stamped and listed in paiSeen, their count is in piSeen.
+ *******************************************************************************/
+int walkSeen(t_solver* ptSol, int iEntryNo, int iDirection, uint32_t uiStamp, int* piSeen) {
+  t_board* ptBoard = &ptSol->tBoard;
+  int      iAtom   = 0;
+  int      iCell   = iEntryNo;
+  int      iFront  = 0;
+  int      aiLook[3] = {0};
+
+  *piSeen = 0;
+
+  while (1) {
+    // Front, front left and front right cell, like lookAhead().
+    iFront    = iCell + ptBoard->aiAhead[iDirection];
+    aiLook[0] = iFront;
+    aiLook[1] = iFront + ptBoard->aiSide[iDirection];
+    aiLook[2] = iFront - ptBoard->aiSide[iDirection];
+    for (int i = 0; i < 3; ++i) {
+      if (ptSol->pacDecided[aiLook[i]] || ptSol->pauiSeen[aiLook[i]] == uiStamp)
+        continue;
+      ptSol->pauiSeen[aiLook[i]]   = uiStamp;
+      ptSol->paiSeen[(*piSeen)++] = aiLook[i];
+    }
+
+    iAtom = lookAhead(ptBoard, iCell, iDirection);
+
+    if (iAtom == ATOM_CENTER) return 0;
+
+    if (iAtom == ATOM_LEFT || iAtom == ATOM_RIGHT) {
+      iDirection = turnBeam(iAtom, iDirection);
+      if (ptBoard->paiGrid[iCell] == CELL_BORDER) return iCell;
+      continue;
+    }
+
+    iCell = goAhead(ptBoard, iCell, iDirection);
+
+    if (ptBoard->paiGrid[iCell] == CELL_BORDER) return iCell;
+  }
+}
+
+/*******************************************************************************
+ * Name:  binomial
+ * Purpose: Returns n choose k, LLONG_MAX if it doesn't fit into a ll.
+ *******************************************************************************/
+ll binomial(int n, int k) {
+  __int128 llRv = 1;
+
+  if (k < 0 || k > n)
+    return 0;
+
+  // Up to n / 2 each step grows, so once too large it stays too large.
+  if (k > n - k)
+    k = n - k;
+
+  // Stays an integer in each step, the product fits into 128 bits.
+  for (int i = 0; i < k; ++i) {
+    llRv = llRv * (n - i) / (i + 1);
+    if (llRv > LLONG_MAX)
+      return LLONG_MAX;
+  }
+
+  return (ll) llRv;
+}
+
+/*******************************************************************************
+ * Name:  addSat
+ * Purpose: Returns a + b of two counts, LLONG_MAX if it doesn't fit into a ll.
+ *******************************************************************************/
+static inline ll addSat(ll llA, ll llB) {
+  return (llA > LLONG_MAX - llB) ? LLONG_MAX : llA + llB;
+}
+
+/*******************************************************************************
+ * Name:  solverCheck
+ * Purpose: Checks all probes not decided yet. Returns -1 if one contradicts,
+ *          else the count of probes still open and in piOpen the cell the first
+ *          of them waits for.
+ *******************************************************************************/
+int solverCheck(t_solver* ptSol, t_probe* patProbes, int iProbes, char* pacDecided, int iDepth, int* piOpen) {
+  t_board* ptBoard = &ptSol->tBoard;
+  int      iCell   = 0;
+  int      iExit   = 0;
+  int      iOpen   = 0;
+  int      iWait   = 0;
+
+  for (int p = 0; p < iProbes; ++p) {
+    // A decided walk never changes, as its cells won't change anymore.
+    if (ptSol->paiDone[p] >= 0)
+      continue;
+
+    iCell = walkOpen(ptBoard, ptSol->paiCell[p], ptSol->paiDir[p], pacDecided, &iWait);
+    if (iCell == WALK_OPEN) {
+      if (iOpen++ == 0)
+        *piOpen = iWait;
+      continue;
+    }
+
+    iExit = (iCell == 0) ? 0 : getExitNode(ptBoard, iCell);
+    if (iExit != patProbes[p].iExit)
+      return -1;
+
+    ptSol->paiDone[p] = iDepth;
+  }
+
+  return iOpen;
+}
+
+/*******************************************************************************
+ * Name:  solverNeeds
+ * Purpose: Returns 1 if the open walks need more atoms than are left. A walk
+ *          which exits wrong with all cells not decided empty needs an atom in
+ *          one of the cells it has seen. Walks seeing disjoint cells need one
+ *          each, so these are counted.
+ *******************************************************************************/
+int solverNeeds(t_solver* ptSol, t_probe* patProbes, int iProbes, int iAtomsLeft) {
+  t_board* ptBoard = &ptSol->tBoard;
+  uint32_t uiClaim = 0;
+  int      iSeen   = 0;
+  int      iCell   = 0;
+  int      iNeeds  = 0;
+  int      bApart  = 0;
+
+  // Stamps would wrap, start over.
+  if (ptSol->uiStamp > UINT32_MAX - (uint32_t) iProbes - 2) {
+    memset(ptSol->pauiSeen,    0, sizeof(uint32_t) * (uint) ptBoard->iCellNo);
+    memset(ptSol->pauiClaimed, 0, sizeof(uint32_t) * (uint) ptBoard->iCellNo);
+    ptSol->uiStamp = 0;
+  }
+  uiClaim = ++ptSol->uiStamp;
+
+  for (int p = 0; p < iProbes; ++p) {
+    if (ptSol->paiDone[p] >= 0)
+      continue;
+
+    iCell = walkSeen(ptSol, ptSol->paiCell[p], ptSol->paiDir[p], ++ptSol->uiStamp, &iSeen);
+    if (((iCell == 0) ? 0 : getExitNode(ptBoard, iCell)) == patProbes[p].iExit)
+      continue;
+
+    bApart = 1;
+    for (int i = 0; i < iSeen && bApart; ++i)
+      bApart = (ptSol->pauiClaimed[ptSol->paiSeen[i]] != uiClaim);
+    if (!bApart)
+      continue;
+
+    if (++iNeeds > iAtomsLeft)
+      return 1;
+    for (int i = 0; i < iSeen; ++i)
+      ptSol->pauiClaimed[ptSol->paiSeen[i]] = uiClaim;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+ * Name:  solverAdd
+ * Purpose: Counts a found solution and keeps it, as long as there is room.
+ *******************************************************************************/
+void solverAdd(t_solver* ptSol, int* paiAtoms, int iAtomNo) {
+  ++ptSol->llSolutions;
+
+  for (int i = 0; i < iAtomNo; ++i)
+    ++ptSol->pallAtoms[paiAtoms[i]];
+
+  if (!ptSol->bKept)
+    return;
+
+  // Too many to keep, next probe needs a full search again.
+  if (ptSol->llSolutions > SOLVER_MAX_KEPT) {
+    ptSol->bKept = 0;
+    return;
+  }
+
+  for (int i = 0; i < iAtomNo; ++i)
+    daAdd(int, ptSol->tCands, paiAtoms[i]);
+}
+
+/*******************************************************************************
+ * Name:  solverAddOpen
+ * Purpose: Adds each way to set the atoms left into the open cells from iFrom
+ *          on, as no beam sees them anyway.
+ *******************************************************************************/
+void solverAddOpen(t_solver* ptSol, int iFrom, int iAtomsLeft) {
+  t_board* ptBoard = &ptSol->tBoard;
+
+  if (iAtomsLeft == 0) {
+    solverAdd(ptSol, ptBoard->paiAtoms, ptBoard->iAtomNo);
+    return;
+  }
+
+  for (int iCell = iFrom; iCell < ptBoard->iCellNo; ++iCell) {
+    if (ptSol->pacDecided[iCell])
+      continue;
+    ptBoard->paiAtoms[ptBoard->iAtomNo - iAtomsLeft] = iCell;
+    solverAddOpen(ptSol, iCell + 1, iAtomsLeft - 1);
+  }
+}
+
+/*******************************************************************************
+ * Name:  solverCountOpen
+ * Purpose: Counts each way to set the atoms left into the open cells without
+ *          going through them, as there are too many to keep anyway.
+ *******************************************************************************/
+void solverCountOpen(t_solver* ptSol, int iOpen, int iAtomsLeft) {
+  t_board* ptBoard = &ptSol->tBoard;
+  ll       llAll   = binomial(iOpen, iAtomsLeft);
+  ll       llCell  = binomial(iOpen - 1, iAtomsLeft - 1);
+
+  // Counts saturate, they may get too large for a ll.
+  ptSol->bKept       = 0;
+  ptSol->llSolutions = addSat(ptSol->llSolutions, llAll);
+
+  for (int i = 0; i < ptBoard->iAtomNo - iAtomsLeft; ++i)
+    ptSol->pallAtoms[ptBoard->paiAtoms[i]] = addSat(ptSol->pallAtoms[ptBoard->paiAtoms[i]], llAll);
+
+  for (int iCell = 0; iCell < ptBoard->iCellNo; ++iCell)
+    if (!ptSol->pacDecided[iCell])
+      ptSol->pallAtoms[iCell] = addSat(ptSol->pallAtoms[iCell], llCell);
+}
+
+/*******************************************************************************
+ * Name:  solverSearch
+ * Purpose: Decides depth first if the cell the next open walk waits for is an
+ *          atom or not, until all walks are decided. Stops after
+ *          SOLVER_MAX_NODES cells, the solutions counted so far are a lower
+ *          bound then.
+ *******************************************************************************/
+void solverSearch(t_solver* ptSol, t_probe* patProbes, int iProbes, int iOpenCells, int iAtomsLeft, int iDepth) {
+  t_board* ptBoard = &ptSol->tBoard;
+  int      iOpen   = 0;
+  int      iCell   = 0;
+
+  // Without atoms left all open cells are empty, so every walk is decided.
+  iOpen = solverCheck(ptSol, patProbes, iProbes,
+                      (iAtomsLeft == 0) ? NULL : ptSol->pacDecided, iDepth, &iCell);
+  if (iOpen < 0)
+    goto undo_and_return;
+
+  // Not enough cells left for the atoms.
+  if (iOpenCells < iAtomsLeft)
+    goto undo_and_return;
+
+  // Each open walk might need an atom of its own.
+  if (iOpen > iAtomsLeft && solverNeeds(ptSol, patProbes, iProbes, iAtomsLeft))
+    goto undo_and_return;
+
+  // All walks decided, so each way to set the atoms left is a solution.
+  if (iOpen == 0) {
+    if (ptSol->bKept && binomial(iOpenCells, iAtomsLeft) <= SOLVER_MAX_KEPT - ptSol->llSolutions)
+      solverAddOpen(ptSol, 0, iAtomsLeft);
+    else
+      solverCountOpen(ptSol, iOpenCells, iAtomsLeft);
+    goto undo_and_return;
+  }
+
+  // Budget is used up, keep what's counted so far.
+  if (++ptSol->llNodes > SOLVER_MAX_NODES) {
+    ptSol->bExhaustive = 0;
+    ptSol->bKept       = 0;
+    goto undo_and_return;
+  }
+
+  ptSol->pacDecided[iCell] = 1;
+
+  // No atom in this cell first, these branches mostly leave more cells no
+  // beam sees, so a search stopped early has counted most solutions ...
+  solverSearch(ptSol, patProbes, iProbes, iOpenCells - 1, iAtomsLeft, iDepth + 1);
+
+  // ... or an atom.
+  ptBoard->paiAtoms[ptBoard->iAtomNo - iAtomsLeft] = iCell;
+  setAtom(ptBoard, iCell, 1);
+  solverSearch(ptSol, patProbes, iProbes, iOpenCells - 1, iAtomsLeft - 1, iDepth + 1);
+  setAtom(ptBoard, iCell, 0);
+
+  ptSol->pacDecided[iCell] = 0;
+
+undo_and_return:
+  // Walks decided here are open again for the other branch.
+  for (int p = 0; p < iProbes; ++p)
+    if (ptSol->paiDone[p] == iDepth)
+      ptSol->paiDone[p] = -1;
+}
+
+/*******************************************************************************
+ * Name:  fitsProbes
+ * Purpose: Returns 1 if the board's beams exit like the probes from iFrom on.
+ *          Bitboards walk their beams on the bitmasks.
+ *******************************************************************************/
+int fitsProbes(t_board* ptBoard, t_solver* ptSol, t_probe* patProbes, int iFrom, int iProbes) {
+  int iCell = 0;
+
+  for (int p = iFrom; p < iProbes; ++p) {
+    if (ptBoard->bBitboard)
+      iCell = walkBits(ptBoard, ptSol->paiCell[p], ptSol->paiDir[p]);
+    else
+      iCell = walkGrid(ptBoard, ptSol->paiCell[p], ptSol->paiDir[p]);
+    if (((iCell == 0) ? 0 : getExitNode(ptBoard, iCell)) != patProbes[p].iExit)
+      return 0;
+  }
+
+  return 1;
+}
+
+/*******************************************************************************
+ * Name:  solverFilter
+ * Purpose: Drops all kept candidates contradicted by the probes from iFrom on.
+ *          Bitboards walk each candidate on its bitmasks, grids walk the new
+ *          probes of a batch of candidates at once with walkGrids().
+ *******************************************************************************/
+void solverFilter(t_solver* ptSol, t_probe* patProbes, int iFrom, int iProbes) {
+  t_board* ptBoard  = &ptSol->tBoard;
+  int      iAtomNo  = ptBoard->iAtomNo;
+  int      iCellNo  = ptBoard->iCellNo;
+  int      iNew     = iProbes - iFrom;
+  int      iGrids   = ptBoard->bBitboard ? 1 : batchGrids(ptBoard);
+  size_t   sCands   = ptSol->tCands.sCount / (size_t) (iAtomNo > 0 ? iAtomNo : 1);
+  size_t   sKept    = 0;
+  size_t   sWalks   = (size_t) iGrids * (size_t) (iNew > 0 ? iNew : 1);
+  int*     paiGrids = ptBoard->bBitboard ? NULL : createGrids(ptBoard, iGrids);
+  int*     paiCells = (int*)  malloc(sizeof(int) * sWalks);
+  int*     paiDirs  = (int*)  malloc(sizeof(int) * sWalks);
+  int*     paiOuts  = (int*)  malloc(sizeof(int) * sWalks);
+  int*     paiWant  = (int*)  malloc(sizeof(int) * (size_t) (iNew > 0 ? iNew : 1));
+  char*    pacMatch = (char*) malloc(sizeof(char) * (size_t) iGrids);
+  int*     paiCand  = NULL;
+  int*     paiGrid  = NULL;
+  int      iBatch   = 0;
+  int      iOut     = 0;
+  int      iDir     = 0;
+
+  ptSol->llSolutions = 0;
+  memset(ptSol->pallAtoms, 0, sizeof(ll) * (uint) iCellNo);
+
+  // Without atoms there is just the one empty candidate, which isn't kept.
+  if (iAtomNo == 0)
+    sCands = 1;
+
+  // Cell each new probe exits at, 0 if absorbed.
+  for (int p = 0; p < iNew; ++p) {
+    paiWant[p] = 0;
+    if (patProbes[iFrom + p].iExit != 0)
+      getEdgeCell(ptBoard, patProbes[iFrom + p].iExit, &paiWant[p], &iDir);
+  }
+
+  for (size_t c = 0; c < sCands; c += (size_t) iBatch) {
+    iBatch = (sCands - c < (size_t) iGrids) ? (int) (sCands - c) : iGrids;
+
+    if (ptBoard->bBitboard) {
+      paiCand = &ptSol->tCands.pVal[c * (size_t) iAtomNo];
+      for (int i = 0; i < iAtomNo; ++i)
+        setAtom(ptBoard, paiCand[i], 1);
+      pacMatch[0] = (char) fitsProbes(ptBoard, ptSol, patProbes, iFrom, iProbes);
+      for (int i = 0; i < iAtomNo; ++i)
+        setAtom(ptBoard, paiCand[i], 0);
+    }
+    else {
+      // Each candidate's atoms on its own grid, all its new probes entering it.
+      for (int g = 0; g < iBatch; ++g) {
+        paiCand = &ptSol->tCands.pVal[(c + (size_t) g) * (size_t) iAtomNo];
+        paiGrid = &paiGrids[(size_t) g * (size_t) iCellNo];
+        for (int i = 0; i < iAtomNo; ++i)
+          paiGrid[paiCand[i]] = CELL_ATOM;
+        for (int p = 0; p < iNew; ++p) {
+          paiCells[g * iNew + p] = g * iCellNo + ptSol->paiCell[iFrom + p];
+          paiDirs[g * iNew + p]  = ptSol->paiDir[iFrom + p];
+        }
+      }
+
+      walkGrids(ptBoard, paiGrids, iBatch, paiCells, paiDirs, paiOuts, iBatch * iNew);
+
+      for (int g = 0; g < iBatch; ++g) {
+        paiCand = &ptSol->tCands.pVal[(c + (size_t) g) * (size_t) iAtomNo];
+        paiGrid = &paiGrids[(size_t) g * (size_t) iCellNo];
+        for (int i = 0; i < iAtomNo; ++i)
+          paiGrid[paiCand[i]] = CELL_EMPTY;
+        pacMatch[g] = 1;
+        for (int p = 0; p < iNew && pacMatch[g]; ++p) {
+          iOut        = paiOuts[g * iNew + p];
+          pacMatch[g] = ((iOut == 0) ? 0 : iOut - g * iCellNo) == paiWant[p];
+        }
+      }
+    }
+
+    // Move candidates to the front of the kept ones, never behind themselves.
+    for (int g = 0; g < iBatch; ++g) {
+      if (!pacMatch[g])
+        continue;
+      paiCand = &ptSol->tCands.pVal[(c + (size_t) g) * (size_t) iAtomNo];
+      memmove(&ptSol->tCands.pVal[sKept * (size_t) iAtomNo], paiCand, sizeof(int) * (size_t) iAtomNo);
+      ++sKept;
+      ++ptSol->llSolutions;
+      for (int i = 0; i < iAtomNo; ++i)
+        ++ptSol->pallAtoms[paiCand[i]];
+    }
+  }
+
+  ptSol->tCands.sCount = sKept * (size_t) iAtomNo;
+
+  free(paiGrids);
+  free(paiCells);
+  free(paiDirs);
+  free(paiOuts);
+  free(paiWant);
+  free(pacMatch);
+}
+
+/*******************************************************************************
+ * Name:  solverMap
+ * Purpose: Maps probes, candidates and counts of the solver from the symmetry
+ *          iFrom of the key to the symmetry iTo, so probes equal but for
+ *          rotations and mirrors aren't searched again. patTmp needs room for
+ *          all probes.
+ *******************************************************************************/
+void solverMap(t_solver* ptSol, int iFrom, int iTo, t_probe* patTmp) {
+  static const int aiInverse[SYM_COUNT] = {0, 3, 2, 1, 4, 5, 6, 7};
+  t_board* ptBoard = &ptSol->tBoard;
+  int      iSize   = ptBoard->iSize;
+  int*     paiMap  = (int*) malloc(sizeof(int) * (uint) ptBoard->iCellNo);
+  ll*      pallTmp = (ll*)  calloc((size_t) ptBoard->iCellNo, sizeof(ll));
+  int      iX      = 0;
+  int      iY      = 0;
+
+  // Into the key's symmetry and out by the inverse of the other one.
+  for (int iCell = 0; iCell < ptBoard->iCellNo; ++iCell) {
+    paiMap[iCell] = iCell;
+    if (ptBoard->paiGrid[iCell] == CELL_BORDER)
+      continue;
+    cellToXY(ptBoard, iCell, &iX, &iY);
+    symmetricXY(iFrom, iSize, iX - 1, iY - 1, &iX, &iY);
+    symmetricXY(aiInverse[iTo], iSize, iX, iY, &iX, &iY);
+    cellFromXY(ptBoard, &paiMap[iCell], iX + 1, iY + 1);
+  }
+
+  for (int iCell = 0; iCell < ptBoard->iCellNo; ++iCell)
+    pallTmp[paiMap[iCell]] = ptSol->pallAtoms[iCell];
+  memcpy(ptSol->pallAtoms, pallTmp, sizeof(ll) * (uint) ptBoard->iCellNo);
+
+  if (ptSol->bKept)
+    for (size_t i = 0; i < ptSol->tCands.sCount; ++i)
+      ptSol->tCands.pVal[i] = paiMap[ptSol->tCands.pVal[i]];
+
+  // A bijection, so no probe is dropped.
+  symmetricProbes(iFrom, iSize, ptSol->tProbes.pVal, ptSol->iProbes, patTmp);
+  symmetricProbes(aiInverse[iTo], iSize, patTmp, ptSol->iProbes, ptSol->tProbes.pVal);
+
+  free(paiMap);
+  free(pallTmp);
+}
+
+/*******************************************************************************
+ * Name:  solveProbes
+ * Purpose: Gets all candidate boards consistent with the probes. Probes are
+ *          taken just once, a beam fired back is the same probe. Probes equal
+ *          to the last ones but for rotations and mirrors map the solutions
+ *          found. Only new probes are checked against kept candidates, if any.
+ *******************************************************************************/
+void solveProbes(t_solver* ptSol, int iSize, int iAtomNo, t_probe* patProbes, int iProbes) {
+  t_board* ptBoard   = &ptSol->tBoard;
+  int      iCells    = iSize * iSize;
+  int      iKey      = iProbes;
+  int      iSym      = 0;
+  int      iDistinct = 0;
+  int      iOld      = 0;
+  int      bSame     = 0;
+  ll       llCell    = 0;
+  t_probe* patKey    = (t_probe*) malloc(sizeof(t_probe) * (size_t) (iProbes + 1));
+  t_probe* patTmp    = (t_probe*) malloc(sizeof(t_probe) * (size_t) (iProbes + 1));
+  char*    pacOld    = (char*)    calloc((size_t) (iProbes + 1), sizeof(char));
+  t_probe* ptFound   = NULL;
+
+  // First call or other game.
+  if (ptBoard->paiGrid == NULL || ptBoard->iSize != iSize || ptBoard->iAtomNo != iAtomNo) {
+    initBoard(ptBoard, iSize, iAtomNo, g_tOpts.bBitboard);
+    ptSol->pallAtoms  = (ll*)   realloc(ptSol->pallAtoms,  sizeof(ll)   * (uint) ptBoard->iCellNo);
+    ptSol->pacDecided = (char*) realloc(ptSol->pacDecided, sizeof(char) * (uint) ptBoard->iCellNo);
+    ptSol->paiSeen    = (int*)  realloc(ptSol->paiSeen,    sizeof(int)  * (uint) ptBoard->iCellNo);
+    free(ptSol->pauiSeen);
+    free(ptSol->pauiClaimed);
+    ptSol->pauiSeen    = (uint32_t*) calloc((size_t) ptBoard->iCellNo, sizeof(uint32_t));
+    ptSol->pauiClaimed = (uint32_t*) calloc((size_t) ptBoard->iCellNo, sizeof(uint32_t));
+    ptSol->uiStamp     = 0;
+
+    // Border cells never hold an atom.
+    for (int iCell = 0; iCell < ptBoard->iCellNo; ++iCell)
+      ptSol->pacDecided[iCell] = (ptBoard->paiGrid[iCell] == CELL_BORDER);
+    ptSol->iProbes   = 0;
+    ptSol->bKept     = 0;
+    ptSol->iKey      = -1;
+    if (ptSol->tProbes.pVal == NULL)
+      daInit(t_probe, ptSol->tProbes);
+    ptSol->tProbes.sCount = 0;
+  }
+
+  // Same canonical probes as the search before, just in another symmetry.
+  iSym  = canonicalGame(iSize, NULL, 0, patProbes, &iKey, NULL, patKey, NULL, patTmp);
+  bSame = (iKey == ptSol->iKey &&
+           (iKey == 0 || memcmp(patKey, ptSol->patKey, sizeof(t_probe) * (size_t) iKey) == 0));
+  if (bSame && iSym != ptSol->iSym)
+    solverMap(ptSol, ptSol->iSym, iSym, patTmp);
+
+  // Probes checked before stay first, unless one of them is gone.
+  if (!bSame) {
+    iDistinct = symmetricProbes(0, iSize, patProbes, iProbes, patTmp);
+    for (int p = 0; p < ptSol->iProbes; ++p) {
+      ptFound = (t_probe*) bsearch(&ptSol->tProbes.pVal[p], patTmp, (size_t) iDistinct,
+                                   sizeof(t_probe), compareProbe);
+      if (ptFound == NULL) {
+        memset(pacOld, 0, sizeof(char) * (size_t) (iProbes + 1));
+        ptSol->iProbes        = 0;
+        ptSol->bKept          = 0;
+        ptSol->tProbes.sCount = 0;
+        break;
+      }
+      pacOld[ptFound - patTmp] = 1;
+    }
+    for (int p = 0; p < iDistinct; ++p)
+      if (!pacOld[p])
+        daAdd(t_probe, ptSol->tProbes, patTmp[p]);
+
+    ptSol->patKey = (t_probe*) realloc(ptSol->patKey, sizeof(t_probe) * (size_t) (iKey + 1));
+    memcpy(ptSol->patKey, patKey, sizeof(t_probe) * (size_t) iKey);
+    ptSol->iKey = iKey;
+  }
+  ptSol->iSym = iSym;
+  iDistinct   = (int) ptSol->tProbes.sCount;
+  iOld        = ptSol->iProbes;
+
+  // Entry cells and directions of all probes.
+  ptSol->paiCell = (int*) realloc(ptSol->paiCell, sizeof(int) * (uint) (iDistinct + 1));
+  ptSol->paiDir  = (int*) realloc(ptSol->paiDir,  sizeof(int) * (uint) (iDistinct + 1));
+  ptSol->paiDone = (int*) realloc(ptSol->paiDone, sizeof(int) * (uint) (iDistinct + 1));
+  for (int p = 0; p < iDistinct; ++p) {
+    getEdgeCell(ptBoard, ptSol->tProbes.pVal[p].iEntry, &ptSol->paiCell[p], &ptSol->paiDir[p]);
+    ptSol->paiDone[p] = -1;
+  }
+  ptSol->iProbes = iDistinct;
+
+  if (bSame)
+    goto free_and_return;
+
+  // Incremental, only the new probes narrow down the kept candidates.
+  if (ptSol->bKept) {
+    solverFilter(ptSol, ptSol->tProbes.pVal, iOld, iDistinct);
+    goto free_and_return;
+  }
+
+  // Without probes every board is a solution, just count them. A cell holds
+  // an atom in each way to set the others into the other cells.
+  if (iProbes == 0) {
+    llCell = binomial(iCells - 1, iAtomNo - 1);
+
+    ptSol->llSolutions = binomial(iCells, iAtomNo);
+    ptSol->bExhaustive = 1;
+    for (int iCell = 0; iCell < ptBoard->iCellNo; ++iCell)
+      ptSol->pallAtoms[iCell] = (ptBoard->paiGrid[iCell] == CELL_BORDER) ? 0 : llCell;
+    goto free_and_return;
+  }
+
+  // Full search.
+  ptSol->llSolutions = 0;
+  ptSol->llNodes     = 0;
+  ptSol->bExhaustive = 1;
+  ptSol->bKept       = 1;
+  memset(ptSol->pallAtoms, 0, sizeof(ll) * (uint) ptBoard->iCellNo);
+  if (ptSol->tCands.pVal == NULL)
+    daInit(int, ptSol->tCands);
+  ptSol->tCands.sCount = 0;
+
+  solverSearch(ptSol, ptSol->tProbes.pVal, iDistinct, iCells, iAtomNo, 0);
+
+free_and_return:
+  free(patKey);
+  free(patTmp);
+  free(pacOld);
+}
+
+/*******************************************************************************
+ * Name:  freeSolver
+ * Purpose: Frees solver's memory.
+ *******************************************************************************/
+void freeSolver(t_solver* ptSol) {
+  freeBoard(&ptSol->tBoard);
+  free(ptSol->pallAtoms);
+  free(ptSol->paiCell);
+  free(ptSol->paiDir);
+  free(ptSol->paiDone);
+  free(ptSol->pacDecided);
+  free(ptSol->pauiSeen);
+  free(ptSol->pauiClaimed);
+  free(ptSol->paiSeen);
+  free(ptSol->tCands.pVal);
+  free(ptSol->tProbes.pVal);
+  free(ptSol->patKey);
+  memset(ptSol, 0, sizeof(t_solver));
+}
+
+/*******************************************************************************
+ * Name:  printSolver
+ * Purpose: Prints count of solutions and a map of forced and forbidden cells.
+ *******************************************************************************/
+void printSolver(t_solver* ptSol) {
+  t_board* ptBoard   = &ptSol->tBoard;
+  int      iCell     = 0;
+  int      iForced   = 0;
+  int      iForbidden = 0;
+  int      bTooMany  = (ptSol->llSolutions == LLONG_MAX);
+
+  printf("\n");
+  if (bTooMany)
+    printf("Solutions left = more than %lld\n", LLONG_MAX - 1);
+  else if (!ptSol->bExhaustive)
+    printf("Solutions left >= %lld, not exhaustive\n", ptSol->llSolutions);
+  else
+    printf("Solutions left = %lld\n", ptSol->llSolutions);
+
+  // A search stopped early just knows the solutions it found.
+  if (!ptSol->bExhaustive)
+    printf("Search stopped after %d cells, the map shows the solutions found\n", SOLVER_MAX_NODES);
+  printf("\n");
+
+  if (ptSol->llSolutions == 0) {
+    printf(ptSol->bExhaustive ? "The beams contradict each other!\n" : "No solution found yet!\n");
+    return;
+  }
+
+  // 'X' is an atom in all solutions, '.' in none and '?' in some. Saturated
+  // counts can't tell all from some, but none stays exact.
+  printf("    ");
+  for (int iX = 1; iX <= ptBoard->iSize; ++iX)
+    printf("%3d", iX);
+  printf("\n");
+
+  for (int iY = 1; iY <= ptBoard->iSize; ++iY) {
+    printf("%3d ", iY);
+    for (int iX = 1; iX <= ptBoard->iSize; ++iX) {
+      cellFromXY(ptBoard, &iCell, iX, iY);
+      if (ptSol->pallAtoms[iCell] == ptSol->llSolutions && !bTooMany) {
+        printf("  X");
+        ++iForced;
+      }
+      else if (ptSol->pallAtoms[iCell] == 0) {
+        printf("  .");
+        ++iForbidden;
+      }
+      else
+        printf("  ?");
+    }
+    printf("\n");
+  }
+
+  if (ptSol->bExhaustive)
+    printf("\nForced atoms = %d, forbidden cells = %d\n", iForced, iForbidden);
+  else
+    printf("\nAtoms in all found = %d, in none found = %d\n", iForced, iForbidden);
+}
+
+/*******************************************************************************
+ * Name:  rateBeams
+ * Purpose: Thread's work, counts all beams' exits of its candidates. Without
+ *          candidates it draws random boards and rates those fitting to all
+ *          probes. Grids walk all beams of a batch of boards at once with
+ *          walkGrids(), bitboards each board's beams on its bitmasks.
+ *******************************************************************************/
+void* rateBeams(void* pvAdv) {
+  t_advisor* ptAdv    = (t_advisor*) pvAdv;
+  t_board    tBoard   = {0};
+  int        iBeams   = 4 * g_tOpts.iSize;
+  int        iNodes   = iBeams + 1;
+  int        iAtomNo  = g_tOpts.iAtomNo;
+  int        iCellNo  = 0;
+  int        iGrids   = 0;
+  int*       paiGrids = NULL;
+  int*       paiAtoms = NULL;
+  int*       paiCells = NULL;
+  int*       paiDirs  = NULL;
+  int*       paiOuts  = NULL;
+  int*       paiNodes = NULL;
+  int*       paiCand  = NULL;
+  int*       paiGrid  = NULL;
+  int        iBatch   = 0;
+
+  // Each thread has its own board and random state, so nothing is shared.
+  initBoard(&tBoard, g_tOpts.iSize, iAtomNo, g_tOpts.bBitboard);
+  iCellNo  = tBoard.iCellNo;
+  iGrids   = tBoard.bBitboard ? 1 : batchGrids(&tBoard);
+  paiGrids = tBoard.bBitboard ? NULL : createGrids(&tBoard, iGrids);
+  paiAtoms = (int*) malloc(sizeof(int) * (size_t) (iGrids * iAtomNo + 1));
+  paiCells = (int*) malloc(sizeof(int) * (size_t) (iGrids * iBeams));
+  paiDirs  = (int*) malloc(sizeof(int) * (size_t) (iGrids * iBeams));
+  paiOuts  = (int*) malloc(sizeof(int) * (size_t) (iGrids * iBeams));
+  paiNodes = (int*) calloc((size_t) (iGrids * iCellNo), sizeof(int));
+
+  // Every grid's beams enter at the same cells, a beam exiting at one comes
+  // out at its node. Cell 0 is a corner, so absorbed beams are node 0.
+  for (int g = 0; g < iGrids; ++g)
+    for (int iBeam = 1; iBeam <= iBeams; ++iBeam) {
+      getEdgeCell(&tBoard, iBeam, &paiCells[g * iBeams + iBeam - 1], &paiDirs[g * iBeams + iBeam - 1]);
+      paiCells[g * iBeams + iBeam - 1] += g * iCellNo;
+      paiNodes[paiCells[g * iBeams + iBeam - 1]] = iBeam;
+    }
+
+  while (ptAdv->sRated < ptAdv->sCands) {
+    // Atoms of a batch of candidates or of random boards fitting.
+    iBatch = 0;
+    while (iBatch < iGrids && ptAdv->sRated + (size_t) iBatch < ptAdv->sCands) {
+      if (ptAdv->paiCands != NULL)
+        paiCand = &ptAdv->paiCands[(ptAdv->sRated + (size_t) iBatch) * (size_t) iAtomNo];
+      else {
+        if (ptAdv->llTries-- <= 0)
+          break;
+        createBoard(&tBoard, &ptAdv->tRand);
+        if (!fitsProbes(&tBoard, ptAdv->ptSol, ptAdv->patProbes, 0, ptAdv->iProbes))
+          continue;
+        paiCand = tBoard.paiAtoms;
+      }
+      memcpy(&paiAtoms[iBatch * iAtomNo], paiCand, sizeof(int) * (size_t) iAtomNo);
+      ++iBatch;
+    }
+    if (iBatch == 0)
+      break;
+
+    if (tBoard.bBitboard) {
+      for (int i = 0; i < iAtomNo; ++i)
+        setAtom(&tBoard, paiAtoms[i], 1);
+      createExitTable(&tBoard);
+      for (int iBeam = 1; iBeam < iNodes; ++iBeam)
+        ++ptAdv->pallHist[(size_t) iBeam * (size_t) iNodes + (size_t) tBoard.paiExits[iBeam]];
+      for (int i = 0; i < iAtomNo; ++i)
+        setAtom(&tBoard, paiAtoms[i], 0);
+    }
+    else {
+      for (int g = 0; g < iBatch; ++g) {
+        paiGrid = &paiGrids[g * iCellNo];
+        for (int i = 0; i < iAtomNo; ++i)
+          paiGrid[paiAtoms[g * iAtomNo + i]] = CELL_ATOM;
+      }
+
+      walkGrids(&tBoard, paiGrids, iBatch, paiCells, paiDirs, paiOuts, iBatch * iBeams);
+
+      for (int g = 0; g < iBatch; ++g) {
+        paiGrid = &paiGrids[g * iCellNo];
+        for (int i = 0; i < iAtomNo; ++i)
+          paiGrid[paiAtoms[g * iAtomNo + i]] = CELL_EMPTY;
+        for (int iBeam = 1; iBeam < iNodes; ++iBeam)
+          ++ptAdv->pallHist[(size_t) iBeam * (size_t) iNodes + (size_t) paiNodes[paiOuts[g * iBeams + iBeam - 1]]];
+      }
+    }
+    ptAdv->sRated += (size_t) iBatch;
+  }
+
+  freeBoard(&tBoard);
+  free(paiGrids);
+  free(paiAtoms);
+  free(paiCells);
+  free(paiDirs);
+  free(paiOuts);
+  free(paiNodes);
+
+  return NULL;
+}
+
+/*******************************************************************************
+ * Name:  adviseProbes
+ * Purpose: Rates each beam not fired yet by the information its outcome gives
+ *          about the candidate boards left and prints the best ones.
+ *******************************************************************************/
+void adviseProbes(t_solver* ptSol, t_probe* patProbes, int iProbes, t_rand* ptRand) {
+  int        iNodes   = 4 * g_tOpts.iSize + 1;
+  int        iAtomNo  = g_tOpts.iAtomNo;
+  int        iThreads = g_tOpts.iThreads;
+  size_t     sKept    = 0;
+  size_t     sRated   = 0;
+  size_t     sWanted  = 0;
+  size_t     sLeft    = 0;
+  int*       paiCands = NULL;
+  ll*        pallHist = (ll*)     calloc((size_t) iNodes * (size_t) iNodes, sizeof(ll));
+  double*    padBits  = (double*) calloc((size_t) iNodes, sizeof(double));
+  double*    padLeft  = (double*) calloc((size_t) iNodes, sizeof(double));
+  int*       paiOuts  = (int*)    calloc((size_t) iNodes, sizeof(int));
+  char*      pacUsed  = (char*)   calloc((size_t) iNodes, sizeof(char));
+  t_advisor* patAdv   = NULL;
+  double     dP       = 0.0;
+  ll         llCount  = 0;
+  int        iBest    = 0;
+
+  solveProbes(ptSol, g_tOpts.iSize, iAtomNo, patProbes, iProbes);
+
+  // A search stopped early might have missed them all, random boards tell.
+  if (ptSol->llSolutions == 0 && ptSol->bExhaustive) {
+    printf("\nThe beams contradict each other!\n");
+    goto free_and_return;
+  }
+
+  // Rate all kept candidates or a uniform selection of them, if too many.
+  if (ptSol->bKept) {
+    sKept    = (iAtomNo == 0) ? 1 : ptSol->tCands.sCount / (size_t) iAtomNo;
+    sWanted  = (sKept < ADVISOR_MAX_RATED) ? sKept : ADVISOR_MAX_RATED;
+    paiCands = (int*) malloc(sizeof(int) * (sWanted * (size_t) iAtomNo + 1));
+    sLeft    = sWanted;
+    for (size_t c = 0; c < sKept && sLeft > 0; ++c) {
+      if (randBelow(ptRand, (uint64_t) (sKept - c)) >= (uint64_t) sLeft)
+        continue;
+      memcpy(&paiCands[(sWanted - sLeft) * (size_t) iAtomNo],
+             &ptSol->tCands.pVal[c * (size_t) iAtomNo], sizeof(int) * (size_t) iAtomNo);
+      --sLeft;
+    }
+  }
+  else
+    sWanted = ADVISOR_MAX_RATED;
+
+  // Not worth a thread for just a few candidates.
+  if ((size_t) iThreads > sWanted / 1000 + 1)
+    iThreads = (int) (sWanted / 1000 + 1);
+
+  // Start all threads with an equal share of candidates.
+  patAdv = (t_advisor*) calloc((size_t) iThreads, sizeof(t_advisor));
+  for (int t = 0; t < iThreads; ++t) {
+    patAdv[t].ptSol     = ptSol;
+    patAdv[t].patProbes = ptSol->tProbes.pVal;
+    patAdv[t].iProbes   = ptSol->iProbes;
+    patAdv[t].sCands    = sWanted / (size_t) iThreads + ((size_t) t < sWanted % (size_t) iThreads);
+    patAdv[t].paiCands  = (paiCands == NULL) ? NULL : &paiCands[sRated * (size_t) iAtomNo];
+    patAdv[t].llTries   = (ll) patAdv[t].sCands * ADVISOR_MAX_TRIES;
+    patAdv[t].tRand     = *ptRand;
+    randJump(ptRand);
+    patAdv[t].pallHist  = (ll*) calloc((size_t) iNodes * (size_t) iNodes, sizeof(ll));
+    if (pallHist == NULL || patAdv[t].pallHist == NULL)
+      dispatchError(ERR_ELSE, "Can't allocate histogram");
+    sRated += patAdv[t].sCands;
+    if (pthread_create(&patAdv[t].tThread, NULL, rateBeams, &patAdv[t]) != 0)
+      dispatchError(ERR_ELSE, "Can't create thread");
+  }
+
+  // Sum up threads' histograms.
+  sRated = 0;
+  for (int t = 0; t < iThreads; ++t) {
+    pthread_join(patAdv[t].tThread, NULL);
+    for (size_t i = 0; i < (size_t) iNodes * (size_t) iNodes; ++i)
+      pallHist[i] += patAdv[t].pallHist[i];
+    sRated += patAdv[t].sRated;
+    free(patAdv[t].pallHist);
+  }
+
+  if (sRated == 0) {
+    printf("\nNo random board fits to all beams, fire some more first!\n");
+    goto free_and_return;
+  }
+
+  // A beam fired or seen exiting already tells nothing new.
+  for (int p = 0; p < iProbes; ++p) {
+    pacUsed[patProbes[p].iEntry] = 1;
+    pacUsed[patProbes[p].iExit]  = 1;
+  }
+
+  // Expected information is the entropy of the beam's outcomes, the expected
+  // count of boards left is the sum of each outcome's share of them.
+  for (int iBeam = 1; iBeam < iNodes; ++iBeam) {
+    for (int iExit = 0; iExit < iNodes; ++iExit) {
+      llCount = pallHist[(size_t) iBeam * (size_t) iNodes + (size_t) iExit];
+      if (llCount == 0)
+        continue;
+      dP               = (double) llCount / (double) sRated;
+      padBits[iBeam]  -= dP * log2(dP);
+      padLeft[iBeam]  += dP * dP;
+      ++paiOuts[iBeam];
+    }
+    padLeft[iBeam] *= (double) ptSol->llSolutions;
+  }
+
+  printf("\n");
+  printf("Candidates rated = %zu of %s%lld%s\n\n", sRated, ptSol->bExhaustive ? "" : "at least ",
+         ptSol->llSolutions,
+         (sRated < (size_t) ptSol->llSolutions) ? " (random selection)" : "");
+  printf("Beam  Bits  Outcomes  Boards left\n");
+
+  for (int i = 0; i < ADVISOR_BEST; ++i) {
+    iBest = 0;
+    for (int iBeam = 1; iBeam < iNodes; ++iBeam)
+      if (!pacUsed[iBeam] && (iBest == 0 || padBits[iBeam] > padBits[iBest]))
+        iBest = iBeam;
+    if (iBest == 0)
+      break;
+    printf("%4d  %4.2f  %8d  %11.0f\n", iBest, padBits[iBest], paiOuts[iBest], padLeft[iBest]);
+    pacUsed[iBest] = 1;
+  }
+
+free_and_return:
+  free(patAdv);
+  free(paiCands);
+  free(pallHist);
+  free(padBits);
+  free(padLeft);
+  free(paiOuts);
+  free(pacUsed);
+}
+
+/*******************************************************************************
+ * Name:  getAtomAnswers
+ * Purpose: Retrieves atom guesses from user and prints if entered correctly.
+ *          The guessed cells are kept in paiGuesses.
+ *******************************************************************************/
+void getAtomAnswers(t_board* ptBoard, int* paiGuesses) {
+  int  iCell = 0;
+  int  iX    = 0;
+  int  iY    = 0;
+
+  printf("\n");
+  printf("Enter coordinates of each Atom as "
+         "y (down) and x (right) (each from 1 to %d)\n\n",
+         ptBoard->iSize);
+
+  for (int i = 0; i < ptBoard->iAtomNo; ++i) {
+    printf("Atom %d of %d\n", i + 1, ptBoard->iAtomNo);
+    printf("y: "); scanf("%20d", &iY);
+    printf("x: "); scanf("%20d", &iX);
+
+    // Range check.
+    if (iY< 1 || iY > ptBoard->iSize ||
+        iX< 1 || iX > ptBoard->iSize) {
+      printf("A coordinate is out of range, try again.\n");
+      --i;
+      continue;
+    }
+
+    printf("you entered down %i and right %i\n", iY, iX);
+
+    cellFromXY(ptBoard, &iCell, iX, iY);
+    paiGuesses[i] = iCell;
+
+    if (ptBoard->paiGrid[iCell] == CELL_ATOM) {
+      printf("Atom Found\n");
+    }
+    else {
+      printf("Atom not found\n");
+    }
+    scoreGuess(&g_tScorer, (iY - 1) * ptBoard->iSize + iX - 1, ptBoard->paiGrid[iCell] == CELL_ATOM);
+    eventGuess(&g_tEvents, iY, iX, ptBoard->paiGrid[iCell] == CELL_ATOM);
+    printf("\n");
+  }
+}
+
+/*******************************************************************************
+ * Name:  renderScore
+ * Purpose: Appends final score to a cstr.
+ *******************************************************************************/
+void renderScore(const t_rules* ptRules, const t_score* ptScore, cstr* pcsOut) {
+  csAppend(pcsOut, "Final score:\n");
+  csAppend(pcsOut, "-------------\n");
+  csAppendf(pcsOut, "Missed Atoms    %3d x %3d = %3d\n",
+            ptScore->iMissedAtoms,
+            ptRules->iAtom,
+            ptRules->iAtom * ptScore->iMissedAtoms);
+  csAppendf(pcsOut, "Exited beams    %3d x %3d = %3d\n",
+            ptScore->iExited,
+            ptRules->iExit,
+            ptRules->iExit * ptScore->iExited);
+  csAppendf(pcsOut, "Reflected beams %3d x %3d = %3d\n",
+            ptScore->iReflected,
+            ptRules->iReflected,
+            ptRules->iReflected * ptScore->iReflected);
+  csAppendf(pcsOut, "Absorbed beams  %3d x %3d = %3d\n",
+            ptScore->iAbsorbed,
+            ptRules->iAbsorbed,
+            ptRules->iAbsorbed * ptScore->iAbsorbed);
+  csAppend(pcsOut, "----------------------------------\n");
+  csAppendf(pcsOut, "Sum total                 = %3lld\n", scoreTotal(ptRules, ptScore));
+}
+
+/*******************************************************************************
+ * Name:  printScore
+ * Purpose: Prints final score.
+ *******************************************************************************/
+void printScore(void) {
+  cstr csOut = csNew("");
+
+  renderScore(g_tScorer.ptRules, &g_tScorer.tScore, &csOut);
+  fputs(csOut.cStr, stdout);
+
+  csFree(&csOut);
+}
+
+
+/*******************************************************************************
+ * Name:  writeRecord
+ * Purpose: Appends a finished game as binary record to a file, with one write()
+ *          past stdio, so records of several threads or processes don't mix.
+ *          The file is opened for appending, so each write() goes to its end.
+ *******************************************************************************/
+void writeRecord(FILE* hFile, ll llSeed, t_board* ptBoard, t_probe* patProbes, int iProbes,
+                 int* paiGuesses, int iGuesses, t_score* ptScore) {
+  size_t    sAtoms     = (((size_t) (ptBoard->iSize * ptBoard->iSize) + 7) / 8 + 3) & ~(size_t) 3;
+  size_t    sBytes     = (sizeof(t_record) + sAtoms + 4 * (size_t) iProbes + 4 * (size_t) iGuesses + 7) & ~(size_t) 7;
+  uint8_t*  paucRecord = (uint8_t*) calloc(sBytes, 1);
+  t_record* ptHead     = (t_record*) paucRecord;
+  uint8_t*  paucAtoms  = paucRecord + sizeof(t_record);
+  uint16_t* pausProbes = (uint16_t*) (paucAtoms + sAtoms);
+  uint32_t* pauiGuess  = (uint32_t*) (pausProbes + 2 * iProbes);
+  int       iX         = 0;
+  int       iY         = 0;
+  int       iBit       = 0;
+
+  ptHead->uiMagic       = REC_MAGIC;
+  ptHead->uiBytes       = (uint32_t) sBytes;
+  ptHead->ullSeed       = (uint64_t) llSeed;
+  ptHead->uiSize        = (uint32_t) ptBoard->iSize;
+  ptHead->uiAtomNo      = (uint32_t) ptBoard->iAtomNo;
+  ptHead->uiProbes      = (uint32_t) iProbes;
+  ptHead->uiGuesses     = (uint32_t) iGuesses;
+  ptHead->uiMissedAtoms = (uint32_t) ptScore->iMissedAtoms;
+  ptHead->uiAbsorbed    = (uint32_t) ptScore->iAbsorbed;
+  ptHead->uiReflected   = (uint32_t) ptScore->iReflected;
+  ptHead->uiExited      = (uint32_t) ptScore->iExited;
+
+  for (int i = 0; i < ptBoard->iAtomsSet; ++i) {
+    cellToXY(ptBoard, ptBoard->paiAtoms[i], &iX, &iY);
+    iBit = (iY - 1) * ptBoard->iSize + iX - 1;
+    paucAtoms[iBit / 8] |= (uint8_t) (1 << (iBit % 8));
+  }
+
+  for (int p = 0; p < iProbes; ++p) {
+    pausProbes[2 * p]     = (uint16_t) patProbes[p].iEntry;
+    pausProbes[2 * p + 1] = (uint16_t) patProbes[p].iExit;
+  }
+
+  for (int g = 0; g < iGuesses; ++g) {
+    cellToXY(ptBoard, paiGuesses[g], &iX, &iY);
+    pauiGuess[g] = (uint32_t) ((iY - 1) * ptBoard->iSize + iX - 1);
+  }
+
+  // Stdio could split a large record into several writes.
+  if (write(fileno(hFile), paucRecord, sBytes) != (ssize_t) sBytes)
+    dispatchError(ERR_FILE, "Can't write game record");
+
+  free(paucRecord);
+}
+
+/*******************************************************************************
+ * Name:  nextRecord
+ * Purpose: Sets view to the record at *ppucPos and moves on behind it. Nothing
+ *          is copied. Returns 0 at the end, -1 if the record is broken and
+ *          REC_FOREIGN if it was written on a host of other byte order.
+ *******************************************************************************/
+int nextRecord(const uint8_t** ppucPos, const uint8_t* pucEnd, t_recordView* ptView) {
+  const t_record* ptHead = (const t_record*) *ppucPos;
+  size_t          sAtoms = 0;
+
+  if (*ppucPos == pucEnd)
+    return 0;
+
+  if ((size_t) (pucEnd - *ppucPos) >= sizeof(t_record) &&
+      ptHead->uiMagic == __builtin_bswap32(REC_MAGIC))
+    return REC_FOREIGN;
+
+  if ((size_t) (pucEnd - *ppucPos) < sizeof(t_record) ||
+      ptHead->uiMagic != REC_MAGIC ||
+      ptHead->uiBytes > (size_t) (pucEnd - *ppucPos) ||
+      ptHead->uiBytes % 8 != 0 ||
+      ptHead->uiSize > REC_MAX_SIZE)
+    return -1;
+
+  sAtoms = (((size_t) ptHead->uiSize * ptHead->uiSize + 7) / 8 + 3) & ~(size_t) 3;
+  if (sizeof(t_record) + sAtoms + 4 * (size_t) ptHead->uiProbes + 4 * (size_t) ptHead->uiGuesses > ptHead->uiBytes)
+    return -1;
+
+  ptView->ptHead      = ptHead;
+  ptView->paucAtoms   = *ppucPos + sizeof(t_record);
+  ptView->pausProbes  = (const uint16_t*) (ptView->paucAtoms + sAtoms);
+  ptView->pauiGuesses = (const uint32_t*) (ptView->pausProbes + 2 * ptHead->uiProbes);
+
+  *ppucPos += ptHead->uiBytes;
+
+  return 1;
+}
+
+/*******************************************************************************
+ * Name:  scoreRecord
+ * Purpose: Scores the game of a record again by the scorer's rules, returns its
+ *          total. Beams off the board's edges are skipped.
+ *******************************************************************************/
+ll scoreRecord(t_scorer* ptSc, const t_recordView* ptView) {
+  const t_record* ptHead  = ptView->ptHead;
+  uint32_t        uiEdges = 4 * ptHead->uiSize;
+  uint32_t        uiCells = ptHead->uiSize * ptHead->uiSize;
+  uint32_t        uiEntry = 0;
+  uint32_t        uiExit  = 0;
+  uint32_t        uiCell  = 0;
+
+  startScore(ptSc, (int) ptHead->uiSize);
+
+  for (uint32_t p = 0; p < ptHead->uiProbes; ++p) {
+    uiEntry = ptView->pausProbes[2 * p];
+    uiExit  = ptView->pausProbes[2 * p + 1];
+    if (uiEntry != 0 && uiEntry <= uiEdges && uiExit <= uiEdges)
+      scoreBeam(ptSc, (int) uiEntry, (int) uiExit);
+  }
+
+  for (uint32_t g = 0; g < ptHead->uiGuesses; ++g) {
+    uiCell = ptView->pauiGuesses[g];
+    scoreGuess(ptSc, (int) uiCell, uiCell < uiCells && (ptView->paucAtoms[uiCell / 8] >> (uiCell % 8)) & 1);
+  }
+
+  endScore(ptSc, (int) ptHead->uiAtomNo);
+
+  return scoreTotal(ptSc->ptRules, &ptSc->tScore);
+}
+
+/*******************************************************************************
+ * Name:  runReplay
+ * Purpose: Maps a file of game records and sums them all up.
+ *******************************************************************************/
+void runReplay(const char* pcFile) {
+  FILE*           hFile      = openFile(pcFile, "r");
+  size_t          sBytes     = getFileSize(hFile);
+  const uint8_t*  paucMap    = NULL;
+  const uint8_t*  pucPos     = NULL;
+  t_recordView    tView      = {0};
+  struct timespec tStart     = {0};
+  struct timespec tEnd       = {0};
+  double          dSecs      = 0.0;
+  ll              llGames    = 0;
+  ll              llProbes   = 0;
+  ll              llAbsorbed = 0;
+  ll              llReflected = 0;
+  ll              llMissed   = 0;
+  int             iRv        = 0;
+  cstr            csMsg      = csNew("");
+  t_scorer        atScorers[RULES_MAX];
+  t_scoreStats    atStats[RULES_MAX];
+
+  // Each set of rules scores each game, all in one pass.
+  for (int r = 0; r < g_tOpts.iRules; ++r) {
+    initScorer(&atScorers[r], &g_tOpts.atRules[r]);
+    memset(&atStats[r], 0, sizeof(t_scoreStats));
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &tStart);
+
+  // An empty file can't be mapped, but has no records anyway.
+  if (sBytes != 0) {
+    paucMap = (const uint8_t*) mmap(NULL, sBytes, PROT_READ, MAP_PRIVATE, fileno(hFile), 0);
+    if (paucMap == MAP_FAILED) {
+      csSetf(&csMsg, "Can't map '%s'", pcFile);
+      dispatchError(ERR_FILE, csMsg.cStr);
+    }
+    madvise((void*) paucMap, sBytes, MADV_SEQUENTIAL);
+  }
+
+  pucPos = paucMap;
+  while ((iRv = nextRecord(&pucPos, paucMap + sBytes, &tView)) > 0) {
+    for (uint32_t p = 0; p < tView.ptHead->uiProbes; ++p) {
+      if      (tView.pausProbes[2 * p + 1] == 0)                     ++llAbsorbed;
+      else if (tView.pausProbes[2 * p + 1] == tView.pausProbes[2 * p]) ++llReflected;
+    }
+
+    for (int r = 0; r < g_tOpts.iRules; ++r)
+      addStats(&atStats[r], scoreRecord(&atScorers[r], &tView));
+    llMissed += tView.ptHead->uiMissedAtoms;
+    llProbes += tView.ptHead->uiProbes;
+    ++llGames;
+  }
+
+  if (iRv < 0) {
+    csSetf(&csMsg, (iRv == REC_FOREIGN) ? "Record at byte %lld of '%s' is of other byte order"
+                                        : "Broken record at byte %lld of '%s'",
+           (ll) (pucPos - paucMap), pcFile);
+    dispatchError(ERR_FILE, csMsg.cStr);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &tEnd);
+  dSecs = (double) (tEnd.tv_sec - tStart.tv_sec) + (double) (tEnd.tv_nsec - tStart.tv_nsec) / 1e9;
+
+  printf("games %lld\n", llGames);
+  printf("probes %lld\n", llProbes);
+  printf("absorbed %lld\n", llAbsorbed);
+  printf("reflected %lld\n", llReflected);
+  printf("exited %lld\n", llProbes - llAbsorbed - llReflected);
+  printf("missed_atoms %lld\n", llMissed);
+  for (int r = 0; r < g_tOpts.iRules; ++r) {
+    printStats(&g_tOpts.atRules[r], &atStats[r]);
+    freeScorer(&atScorers[r]);
+    free(atStats[r].pallHist);
+  }
+  printf("# %zu bytes in %.3f s = %.0f MB/s\n", sBytes, dSecs, (double) sBytes / 1e6 / dSecs);
+
+  if (paucMap != NULL)
+    munmap((void*) paucMap, sBytes);
+  csFree(&csMsg);
+  fclose(hFile);
+}
+
+/*******************************************************************************
+ * Name:  getRecordAtoms
+ * Purpose: Gets the atoms of a record as inner cells y * size + x, counted
+ *          from 0. Returns count of atoms, at most iMax.
+ *******************************************************************************/
+int getRecordAtoms(const t_recordView* ptView, int* paiCells, int iMax) {
+  int iCells = (int) (ptView->ptHead->uiSize * ptView->ptHead->uiSize);
+  int iAtoms = 0;
+
+  for (int iByte = 0; iByte < (iCells + 7) / 8; ++iByte) {
+    if (ptView->paucAtoms[iByte] == 0)
+      continue;
+    for (int iBit = 0; iBit < 8 && iAtoms < iMax; ++iBit)
+      if (ptView->paucAtoms[iByte] & (1 << iBit))
+        paiCells[iAtoms++] = iByte * 8 + iBit;
+  }
+
+  return iAtoms;
+}
+
+/*******************************************************************************
+ * Name:  compareIndex
+ * Purpose: Compares two index entries for qsort() and bsearch().
+ *******************************************************************************/
+int compareIndex(const void* pvA, const void* pvB) {
+  const t_index* ptA = (const t_index*) pvA;
+  const t_index* ptB = (const t_index*) pvB;
+
+  if (ptA->uiSize   != ptB->uiSize)   return (ptA->uiSize   > ptB->uiSize)   ? 1 : -1;
+  if (ptA->uiAtomNo != ptB->uiAtomNo) return (ptA->uiAtomNo > ptB->uiAtomNo) ? 1 : -1;
+  if (ptA->ullHash  != ptB->ullHash)  return (ptA->ullHash  > ptB->ullHash)  ? 1 : -1;
+
+  return (ptA->ullOffset > ptB->ullOffset) - (ptA->ullOffset < ptB->ullOffset);
+}
+
+/*******************************************************************************
+ * Name:  mapFile
+ * Purpose: Maps a whole file read only, returns NULL if it's empty.
+ *******************************************************************************/
+const uint8_t* mapFile(FILE* hFile, size_t sBytes, const char* pcFile) {
+  const uint8_t* paucMap = NULL;
+  cstr           csMsg   = csNew("");
+
+  // An empty file can't be mapped.
+  if (sBytes == 0)
+    return NULL;
+
+  paucMap = (const uint8_t*) mmap(NULL, sBytes, PROT_READ, MAP_PRIVATE, fileno(hFile), 0);
+  if (paucMap == MAP_FAILED) {
+    csSetf(&csMsg, "Can't map '%s'", pcFile);
+    dispatchError(ERR_FILE, csMsg.cStr);
+  }
+
+  csFree(&csMsg);
+
+  return paucMap;
+}
+
+/*******************************************************************************
+ * Name:  runIndex
+ * Purpose: Writes the index of a record file, sorted by board size, atoms and
+ *          the hash of the canonical atoms, so lookups are binary searches.
+ *******************************************************************************/
+void runIndex(const char* pcFile) {
+  FILE*           hFile     = openFile(pcFile, "r");
+  FILE*           hIndex    = NULL;
+  size_t          sBytes    = getFileSize(hFile);
+  const uint8_t*  paucMap   = mapFile(hFile, sBytes, pcFile);
+  const uint8_t*  pucPos    = paucMap;
+  t_recordView    tView     = {0};
+  t_indexHead     tHead     = {IDX_MAGIC, 0, 0, sBytes};
+  t_array(int)    tCells;
+  t_array(int)    tCanon;
+  t_array(int)    tTmp;
+  t_index*        patIndex  = NULL;
+  size_t          sCapacity = 1024;
+  int             iAtoms    = 0;
+  int             iRv       = 0;
+  cstr            csIdx     = csNew("");
+
+  daInit(int, tCells);
+  daInit(int, tCanon);
+  daInit(int, tTmp);
+  patIndex = (t_index*) malloc(sizeof(t_index) * sCapacity);
+
+  while ((iRv = nextRecord(&pucPos, paucMap + sBytes, &tView)) > 0) {
+    // Room for all atoms of this board.
+    if (tView.ptHead->uiAtomNo > tCells.sCapacity) {
+      tCells.sCapacity = tCanon.sCapacity = tTmp.sCapacity = tView.ptHead->uiAtomNo;
+      tCells.pVal = (int*) realloc(tCells.pVal, sizeof(int) * tCells.sCapacity);
+      tCanon.pVal = (int*) realloc(tCanon.pVal, sizeof(int) * tCanon.sCapacity);
+      tTmp.pVal   = (int*) realloc(tTmp.pVal,   sizeof(int) * tTmp.sCapacity);
+    }
+
+    iAtoms = getRecordAtoms(&tView, tCells.pVal, (int) tView.ptHead->uiAtomNo);
+    canonicalAtoms((int) tView.ptHead->uiSize, tCells.pVal, iAtoms, tCanon.pVal, tTmp.pVal);
+
+    if (tHead.ullEntries == sCapacity) {
+      sCapacity *= 2;
+      patIndex   = (t_index*) realloc(patIndex, sizeof(t_index) * sCapacity);
+    }
+    patIndex[tHead.ullEntries].ullHash   = hashAtoms((int) tView.ptHead->uiSize, tCanon.pVal, iAtoms);
+    patIndex[tHead.ullEntries].uiSize    = tView.ptHead->uiSize;
+    patIndex[tHead.ullEntries].uiAtomNo  = tView.ptHead->uiAtomNo;
+    patIndex[tHead.ullEntries].ullOffset = (uint64_t) ((const uint8_t*) tView.ptHead - paucMap);
+    ++tHead.ullEntries;
+  }
+
+  if (iRv < 0) {
+    csSetf(&csIdx, (iRv == REC_FOREIGN) ? "Record at byte %lld of '%s' is of other byte order"
+                                        : "Broken record at byte %lld of '%s'",
+           (ll) (pucPos - paucMap), pcFile);
+    dispatchError(ERR_FILE, csIdx.cStr);
+  }
+
+  qsort(patIndex, (size_t) tHead.ullEntries, sizeof(t_index), compareIndex);
+
+  csSetf(&csIdx, "%s" IDX_SUFFIX, pcFile);
+  hIndex = openFile(csIdx.cStr, "wb");
+  if (fwrite(&tHead, sizeof(tHead), 1, hIndex) != 1 ||
+      fwrite(patIndex, sizeof(t_index), (size_t) tHead.ullEntries, hIndex) != tHead.ullEntries)
+    dispatchError(ERR_FILE, "Can't write index");
+  fclose(hIndex);
+
+  printf("# indexed %llu games of '%s' into '%s'\n",
+         (unsigned long long) tHead.ullEntries, pcFile, csIdx.cStr);
+
+  if (paucMap != NULL)
+    munmap((void*) paucMap, sBytes);
+  daFree(tCells);
+  daFree(tCanon);
+  daFree(tTmp);
+  free(patIndex);
+  csFree(&csIdx);
+  fclose(hFile);
+}
+
+/*******************************************************************************
+ * Name:  runFind
+ * Purpose: Lists all recorded games on a board like the one of the options,
+ *          with a binary search in the record file's index.
+ *******************************************************************************/
+void runFind(const char* pcFile) {
+  FILE*              hFile      = openFile(pcFile, "r");
+  FILE*              hIndex     = NULL;
+  size_t             sBytes     = getFileSize(hFile);
+  size_t             sIdxBytes  = 0;
+  const uint8_t*     paucMap    = mapFile(hFile, sBytes, pcFile);
+  const uint8_t*     paucIdx    = NULL;
+  const uint8_t*     pucPos     = NULL;
+  const t_indexHead* ptHead     = NULL;
+  const t_index*     patIndex   = NULL;
+  t_index            tKey       = {0};
+  t_recordView       tView      = {0};
+  t_board            tBoard     = {0};
+  t_rand             tRand      = {0};
+  int*               paiCells   = (int*) malloc(sizeof(int) * (size_t) (g_tOpts.iAtomNo + 1));
+  int*               paiCanon   = (int*) malloc(sizeof(int) * (size_t) (g_tOpts.iAtomNo + 1));
+  int*               paiTmp     = (int*) malloc(sizeof(int) * (size_t) (g_tOpts.iAtomNo + 1));
+  int*               paiOther   = (int*) malloc(sizeof(int) * (size_t) (g_tOpts.iAtomNo + 1));
+  size_t             sLow       = 0;
+  size_t             sHigh      = 0;
+  size_t             sMid       = 0;
+  ll                 llGames    = 0;
+  ll                 llScore    = 0;
+  ll                 llSum      = 0;
+  int                iAtoms     = 0;
+  cstr               csIdx      = csNew("");
+  t_scorer           tScorer    = {0};
+
+  // Games are scored by the first rules.
+  initScorer(&tScorer, &g_tOpts.atRules[0]);
+
+  // The board asked for, like the game creates it.
+  randSeed(&tRand, (uint64_t) g_tOpts.llSeed);
+  initBoard(&tBoard, g_tOpts.iSize, g_tOpts.iAtomNo, 0);
+  createBoard(&tBoard, &tRand);
+  iAtoms = getInnerAtoms(&tBoard, paiCells);
+  canonicalAtoms(g_tOpts.iSize, paiCells, iAtoms, paiCanon, paiTmp);
+
+  tKey.uiSize   = (uint32_t) g_tOpts.iSize;
+  tKey.uiAtomNo = (uint32_t) g_tOpts.iAtomNo;
+  tKey.ullHash  = hashAtoms(g_tOpts.iSize, paiCanon, iAtoms);
+
+  csSetf(&csIdx, "%s" IDX_SUFFIX, pcFile);
+  hIndex    = openFile(csIdx.cStr, "r");
+  sIdxBytes = getFileSize(hIndex);
+  paucIdx   = mapFile(hIndex, sIdxBytes, csIdx.cStr);
+  ptHead    = (const t_indexHead*) paucIdx;
+  if (sIdxBytes < sizeof(t_indexHead) || ptHead->uiMagic != IDX_MAGIC ||
+      sIdxBytes != sizeof(t_indexHead) + sizeof(t_index) * ptHead->ullEntries)
+    dispatchError(ERR_FILE, "Index is broken");
+  if (ptHead->ullFileSize != sBytes)
+    dispatchError(ERR_FILE, "Index is out of date, run '--index' again");
+  patIndex = (const t_index*) (paucIdx + sizeof(t_indexHead));
+
+  // Lower bound of the key, the least offset sorts first.
+  sLow  = 0;
+  sHigh = (size_t) ptHead->ullEntries;
+  while (sLow < sHigh) {
+    sMid = sLow + (sHigh - sLow) / 2;
+    if (compareIndex(&patIndex[sMid], &tKey) < 0)
+      sLow  = sMid + 1;
+    else
+      sHigh = sMid;
+  }
+
+  printf("# games on boards like seed %lld, size %d, atoms %d\n",
+         g_tOpts.llSeed, g_tOpts.iSize, g_tOpts.iAtomNo);
+  printf("# offset seed probes missed score\n");
+
+  for (size_t i = sLow; i < ptHead->ullEntries; ++i) {
+    if (patIndex[i].uiSize != tKey.uiSize || patIndex[i].uiAtomNo != tKey.uiAtomNo ||
+        patIndex[i].ullHash != tKey.ullHash)
+      break;
+
+    // Hashes may collide, so compare the atoms, too.
+    pucPos = paucMap + patIndex[i].ullOffset;
+    if (nextRecord(&pucPos, paucMap + sBytes, &tView) <= 0)
+      dispatchError(ERR_FILE, "Index doesn't fit to record file");
+    if (getRecordAtoms(&tView, paiOther, iAtoms) != iAtoms)
+      continue;
+    canonicalAtoms(g_tOpts.iSize, paiOther, iAtoms, paiTmp, paiCells);
+    if (memcmp(paiTmp, paiCanon, sizeof(int) * (size_t) iAtoms) != 0)
+      continue;
+
+    llScore = scoreRecord(&tScorer, &tView);
+    llSum  += llScore;
+    ++llGames;
+
+    printf("%llu %llu %u %u %lld\n", (unsigned long long) patIndex[i].ullOffset,
+           (unsigned long long) tView.ptHead->ullSeed, tView.ptHead->uiProbes,
+           tView.ptHead->uiMissedAtoms, llScore);
+  }
+
+  printf("# games %lld, score mean %.3f\n", llGames, (llGames == 0) ? 0.0 : (double) llSum / (double) llGames);
+
+  if (paucMap != NULL)
+    munmap((void*) paucMap, sBytes);
+  munmap((void*) paucIdx, sIdxBytes);
+  freeBoard(&tBoard);
+  freeScorer(&tScorer);
+  free(paiCells);
+  free(paiCanon);
+  free(paiTmp);
+  free(paiOther);
+  csFree(&csIdx);
+  fclose(hIndex);
+  fclose(hFile);
+}
+
+/*******************************************************************************
+ * Name:  runBatch
+ * Purpose: Replays all games of a batch file and prints one record per beam.
+ *******************************************************************************/
+void runBatch(const char* pcFile) {
+  FILE* hFile      = openFile(pcFile, "r");
+  cstr  csLine     = csNew("");
+  char* pcLine     = NULL;
+  char* pcPos      = NULL;
+  char* pcEnd      = NULL;
+  ll    llGame     = 0;
+  ll    llSeed     = 0;
+  int   iSize      = 0;
+  int   iAtomNo    = 0;
+  int   iNodeEntry = 0;
+  int   iNodeExit  = 0;
+  ll    llLen      = 0;
+  t_rand  tRand    = {0};
+  t_board tBoard   = {0};
+  cstr_reader tReader = csReaderNew(hFile);
+
+  // Lines are just views into the reader's buffer, no copies.
+  while (csReadView(&tReader, &pcLine, &llLen)) {
+    // Skip empty lines and comments.
+    pcPos = pcLine;
+    while (*pcPos == ' ' || *pcPos == '\t') ++pcPos;
+    if (*pcPos == '\0' || *pcPos == '#')
+      continue;
+
+    // Board parameters.
+    llSeed  =       strtoll(pcPos, &pcEnd, 10); pcPos = pcEnd;
+    iSize   = (int) strtol (pcPos, &pcEnd, 10); pcPos = pcEnd;
+    iAtomNo = (int) strtol (pcPos, &pcEnd, 10); pcPos = pcEnd;
+    ++llGame;
+
+    if (iSize < 1 || iSize > GRID_MAX_SIZE || iAtomNo < 0 || iAtomNo > (ll) iSize * iSize) {
+      csSetf(&csLine, "Invalid board in game %lld of '%s'", llGame, pcFile);
+      dispatchError(ERR_FILE, csLine.cStr);
+    }
+
+    randSeed(&tRand, (uint64_t) llSeed);
+    initBoard(&tBoard, iSize, iAtomNo, g_tOpts.bBitboard);
+    createBoard(&tBoard, &tRand);
+    createExitTable(&tBoard);
+
+    // All beams till end of line.
+    while (1) {
+      iNodeEntry = (int) strtol(pcPos, &pcEnd, 10);
+      if (pcEnd == pcPos)
+        break;
+      pcPos = pcEnd;
+
+      printf("%lld %lld %d ", llGame, llSeed, iNodeEntry);
+
+      if (iNodeEntry < 1 || iNodeEntry > 4 * tBoard.iSize) {
+        printf(RES_INVALID "\n");
+        continue;
+      }
+
+      iNodeExit = tBoard.paiExits[iNodeEntry];
+
+      if      (iNodeExit == iNodeEntry) printf(RES_REFLECTED "\n");
+      else if (iNodeExit == 0)          printf(RES_ABSORBED "\n");
+      else                              printf("%d\n", iNodeExit);
+    }
+  }
+
+  if (tReader.bError) {
+    csSetf(&csLine, "Can't read '%s'", pcFile);
+    dispatchError(ERR_FILE, csLine.cStr);
+  }
+
+  freeBoard(&tBoard);
+  csReaderFree(&tReader);
+  csFree(&csLine);
+  fclose(hFile);
+}
+
+/*******************************************************************************
+ * Name:  simulateBoards
+ * Purpose: Thread's work, creates random boards and counts all beams' exits.
+ *******************************************************************************/
+void* simulateBoards(void* pvSim) {
+  t_simulation* ptSim  = (t_simulation*) pvSim;
+  t_board       tBoard = {0};
+  t_rand        tRand  = ptSim->tRand;
+  int           iNodes = 4 * g_tOpts.iSize + 1;
+
+  // Each thread has its own board and random state, so nothing is shared.
+  // The random state is drawn from a local copy, as the threads' structs
+  // lie next to each other and would share cache lines.
+  initBoard(&tBoard, g_tOpts.iSize, g_tOpts.iAtomNo, g_tOpts.bBitboard);
+
+  for (ll i = 0; i < ptSim->llBoards; ++i) {
+    createBoard(&tBoard, &tRand);
+    createExitTable(&tBoard);
+    for (int iBeam = 1; iBeam < iNodes; ++iBeam)
+      ++ptSim->pallHist[(size_t) iBeam * (size_t) iNodes + (size_t) tBoard.paiExits[iBeam]];
+  }
+
+  ptSim->tRand = tRand;
+  freeBoard(&tBoard);
+
+  return NULL;
+}
+
+/*******************************************************************************
+ * Name:  simulateSparse
+ * Purpose: Same as simulateBoards(), but on sparse boards, counting per entry
+ *          just absorbed and reflected beams.
+ *******************************************************************************/
+void* simulateSparse(void* pvSim) {
+  t_simulation* ptSim  = (t_simulation*) pvSim;
+  t_sparse      tSp    = {0};
+  t_rand        tRand  = ptSim->tRand;
+  int           iNodes = 4 * g_tOpts.iSize + 1;
+  int           iExit  = 0;
+  int           iOff   = 0;
+
+  initSparse(&tSp, g_tOpts.iSize, g_tOpts.iAtomNo);
+
+  for (ll i = 0; i < ptSim->llBoards; ++i) {
+    createSparse(&tSp, &tRand);
+
+    for (int iBeam = 1; iBeam < iNodes; ++iBeam) {
+      iExit = walkSparse(&tSp, iBeam);
+      if (iExit != 0 && iExit != iBeam)
+        continue;
+
+      iOff = (iExit == 0) ? 0 : 1;
+      ++ptSim->pallHist[iBeam * 2 + iOff];
+    }
+  }
+
+  ptSim->tRand = tRand;
+  freeSparse(&tSp);
+
+  return NULL;
+}
+
+/*******************************************************************************
+ * Name:  runSimulation
+ * Purpose: Spreads random boards over threads and prints the beams' statistic.
+ *******************************************************************************/
+void runSimulation(void) {
+  int           iNodes   = 4 * g_tOpts.iSize + 1;
+  int           iThreads = g_tOpts.iThreads;
+  t_rand        tRand    = {0};
+  ll            llAbsorbed  = 0;
+  ll            llReflected = 0;
+  ll            llExited    = 0;
+  size_t        sHist    = (size_t) iNodes * (size_t) (g_tOpts.bSparse ? 2 : iNodes);
+  ll*           pallHist = (ll*) calloc(sHist, sizeof(ll));
+  t_simulation* patSim   = (t_simulation*) calloc((size_t) iThreads, sizeof(t_simulation));
+
+  // Start all threads with an equal share of boards, each with its own stream
+  // of random numbers split off the seed.
+  randSeed(&tRand, (uint64_t) g_tOpts.llSeed);
+  for (int t = 0; t < iThreads; ++t) {
+    patSim[t].llBoards = g_tOpts.llSimulate / iThreads;
+    if (t < g_tOpts.llSimulate % iThreads)
+      ++patSim[t].llBoards;
+    patSim[t].tRand    = tRand;
+    randJump(&tRand);
+    patSim[t].pallHist = (ll*) calloc(sHist, sizeof(ll));
+    if (pallHist == NULL || patSim[t].pallHist == NULL)
+      dispatchError(ERR_ELSE, "Can't allocate histogram, try '--sparse'");
+    if (pthread_create(&patSim[t].tThread, NULL, g_tOpts.bSparse ? simulateSparse : simulateBoards, &patSim[t]) != 0)
+      dispatchError(ERR_ELSE, "Can't create thread");
+  }
+
+  // Sum up threads' histograms.
+  for (int t = 0; t < iThreads; ++t) {
+    pthread_join(patSim[t].tThread, NULL);
+    for (size_t i = 0; i < sHist; ++i)
+      pallHist[i] += patSim[t].pallHist[i];
+    free(patSim[t].pallHist);
+  }
+
+  printf("# boards %lld, size %d, atoms %d, threads %d, seed %lld\n",
+         g_tOpts.llSimulate, g_tOpts.iSize, g_tOpts.iAtomNo, iThreads, g_tOpts.llSeed);
+
+  if (g_tOpts.bSparse) {
+    printf("# entry absorbed reflected exited\n");
+    for (int iEntry = 1; iEntry < iNodes; ++iEntry)
+      printf("%d %lld %lld %lld\n", iEntry, pallHist[iEntry * 2], pallHist[iEntry * 2 + 1],
+             g_tOpts.llSimulate - pallHist[iEntry * 2] - pallHist[iEntry * 2 + 1]);
+  }
+  else
+    printf("# entry absorbed reflected exited exit:count ...\n");
+
+  for (int iEntry = 1; iEntry < iNodes && !g_tOpts.bSparse; ++iEntry) {
+    llAbsorbed  = pallHist[(size_t) iEntry * (size_t) iNodes];
+    llReflected = pallHist[(size_t) iEntry * (size_t) iNodes + (size_t) iEntry];
+    llExited    = g_tOpts.llSimulate - llAbsorbed - llReflected;
+
+    printf("%d %lld %lld %lld", iEntry, llAbsorbed, llReflected, llExited);
+    for (int iExit = 1; iExit < iNodes; ++iExit)
+      if (iExit != iEntry && pallHist[(size_t) iEntry * (size_t) iNodes + (size_t) iExit] != 0)
+        printf(" %d:%lld", iExit, pallHist[(size_t) iEntry * (size_t) iNodes + (size_t) iExit]);
+    printf("\n");
+  }
+
+  free(patSim);
+  free(pallHist);
+}
+
+
+/*******************************************************************************
+ * Name:  hashRow
+ * Purpose: Returns the FNV-1a hash of a table's row.
+ *******************************************************************************/
+static inline uint64_t hashRow(const uint8_t* paucRow, int iBeams) {
+  uint64_t ullHash = 0xcbf29ce484222325ULL;
+
+  for (int i = 0; i < iBeams; ++i)
+    ullHash = (ullHash ^ (uint64_t) paucRow[i]) * 0x100000001b3ULL;
+
+  return ullHash;
+}
+
+/*******************************************************************************
+ * Name:  rankAtoms
+ * Purpose: Returns the rank in colex order of ascending inner cells.
+ *******************************************************************************/
+static inline uint64_t rankAtoms(const ll* pallBinom, const int* paiCells, int iAtoms) {
+  uint64_t ullRank = 0;
+
+  for (int i = 0; i < iAtoms; ++i)
+    ullRank += (uint64_t) pallBinom[paiCells[i] * (iAtoms + 1) + i + 1];
+
+  return ullRank;
+}
+
+/*******************************************************************************
+ * Name:  visitImages
+ * Purpose: Puts the rows of all images of the walked board into the table,
+ *          mapping its exits like its atoms. The key takes the least row, so
+ *          boards whose rows are images of each other share a class of rows.
+ *******************************************************************************/
+void visitImages(t_enumerator* ptEnum) {
+  t_board*  ptBoard = &ptEnum->tBoard;
+  int       iAtomNo = ptBoard->iAtomNo;
+  int       iBeams  = 4 * ptBoard->iSize;
+  int       iCells  = ptBoard->iSize * ptBoard->iSize;
+  int       iLeast  = 0;
+  int       bNew    = 0;
+  int*      paiMap  = NULL;
+  uint8_t*  paucRow = NULL;
+  t_enumKey tKey    = {0};
+
+  // Images' rows lie all over the table, so they are fetched at once.
+  for (int iSym = 0; iSym < SYM_COUNT; ++iSym) {
+    symmetricAtoms(&ptEnum->paiSymCells[iSym * iCells], ptEnum->paiComb, iAtomNo, ptEnum->paiImage);
+    ptEnum->allRanks[iSym] = (ll) rankAtoms(ptEnum->pallBinom, ptEnum->paiImage, iAtomNo);
+    __builtin_prefetch(&ptEnum->paucTable[(uint64_t) ptEnum->allRanks[iSym] * (uint64_t) iBeams], 1);
+  }
+
+  for (int iSym = 0; iSym < SYM_COUNT; ++iSym) {
+    // Beam entering at the image of an edge exits at the image of its exit.
+    paiMap  = &ptEnum->paiSymEdges[iSym * (iBeams + 1)];
+    paucRow = &ptEnum->paucRows[iSym * iBeams];
+    for (int iBeam = 1; iBeam <= iBeams; ++iBeam)
+      paucRow[paiMap[iBeam] - 1] = (uint8_t) paiMap[ptBoard->paiExits[iBeam]];
+
+    // Symmetric boards are their own images, count and write each once.
+    bNew = 1;
+    for (int i = 0; i < iSym && bNew; ++i)
+      bNew = (ptEnum->allRanks[i] != ptEnum->allRanks[iSym]);
+    if (bNew) {
+      ++tKey.uiBoards;
+      memcpy(&ptEnum->paucTable[(uint64_t) ptEnum->allRanks[iSym] * (uint64_t) iBeams], paucRow, (size_t) iBeams);
+    }
+
+    bNew = 1;
+    for (int i = 0; i < iSym && bNew; ++i)
+      bNew = (memcmp(&ptEnum->paucRows[i * iBeams], paucRow, (size_t) iBeams) != 0);
+    if (bNew)
+      ++tKey.uiRows;
+
+    if (memcmp(paucRow, &ptEnum->paucRows[iLeast * iBeams], (size_t) iBeams) < 0)
+      iLeast = iSym;
+  }
+
+  tKey.ullHash = hashRow(&ptEnum->paucRows[iLeast * iBeams], iBeams);
+  tKey.ullRank = (uint64_t) ptEnum->allRanks[iLeast];
+  daAdd(t_enumKey, ptEnum->tKeys, tKey);
+}
+
+/*******************************************************************************
+ * Name:  visitBoard
+ * Purpose: Turns the board into the atoms of paiComb, just moving those which
+ *          differ from the board walked before, walks the beams which passed
+ *          them again and puts the board's exits into the table. With
+ *          symmetry just canonical boards are walked, for all their images.
+ *******************************************************************************/
+void visitBoard(t_enumerator* ptEnum) {
+  t_board*  ptBoard = &ptEnum->tBoard;
+  int       iAtomNo = ptBoard->iAtomNo;
+  int       iBeams  = 4 * ptBoard->iSize;
+  int       iCell   = 0;
+  uint8_t*  paucRow = NULL;
+  t_enumKey tKey    = {0};
+
+  if (ptEnum->paiSymEdges != NULL &&
+      !isCanonicalAtoms(ptEnum->paiSymCells, ptBoard->iSize * ptBoard->iSize, ptEnum->paiComb, iAtomNo, ptEnum->paiImage))
+    return;
+
+  for (int i = 0; i < iAtomNo; ++i)
+    ptEnum->pacIn[ptEnum->paiComb[i]] = 1;
+
+  // Take away atoms gone, ...
+  for (int i = 0; i < iAtomNo; ++i) {
+    if (ptEnum->paiPrev[i] < 0 || ptEnum->pacIn[ptEnum->paiPrev[i]])
+      continue;
+    cellFromXY(ptBoard, &iCell, ptEnum->paiPrev[i] % ptBoard->iSize + 1, ptEnum->paiPrev[i] / ptBoard->iSize + 1);
+    setCachedAtom(&ptEnum->tCache, ptBoard, iCell, 0);
+  }
+
+  // ... and set new ones.
+  for (int i = 0; i < iAtomNo; ++i) {
+    cellFromXY(ptBoard, &iCell, ptEnum->paiComb[i] % ptBoard->iSize + 1, ptEnum->paiComb[i] / ptBoard->iSize + 1);
+    setCachedAtom(&ptEnum->tCache, ptBoard, iCell, 1);
+    ptEnum->pacIn[ptEnum->paiComb[i]] = 0;
+    ptEnum->paiPrev[i]                = ptEnum->paiComb[i];
+  }
+
+  updateExitTable(&ptEnum->tCache, ptBoard);
+  ++ptEnum->llWalked;
+
+  if (ptEnum->paiSymEdges != NULL) {
+    visitImages(ptEnum);
+    return;
+  }
+
+  tKey.ullRank  = rankAtoms(ptEnum->pallBinom, ptEnum->paiComb, iAtomNo);
+  tKey.uiBoards = 1;
+  tKey.uiRows   = 1;
+  paucRow = &ptEnum->paucTable[tKey.ullRank * (uint64_t) iBeams];
+  for (int iBeam = 1; iBeam <= iBeams; ++iBeam)
+    paucRow[iBeam - 1] = (uint8_t) ptBoard->paiExits[iBeam];
+  tKey.ullHash = hashRow(paucRow, iBeams);
+  daAdd(t_enumKey, ptEnum->tKeys, tKey);
+}
+
+/*******************************************************************************
+ * Name:  revolveBoards
+ * Purpose: Visits all ways to set iAtoms atoms into the inner cells below
+ *          iCells, in revolving door order, so next board moves just one atom.
+ *          The atoms above are in paiComb from iAtoms on already. Returns the
+ *          count of boards visited.
+ *******************************************************************************/
+ll revolveBoards(t_enumerator* ptEnum, int iCells, int iAtoms, int bBackwards) {
+  ll llBoards = 0;
+
+  // All cells or none hold an atom.
+  if (iAtoms == 0 || iAtoms == iCells) {
+    for (int i = 0; i < iAtoms; ++i)
+      ptEnum->paiComb[i] = i;
+    visitBoard(ptEnum);
+    return 1;
+  }
+
+  // Boards without an atom in the top cell, then those with it, mirrored
+  // when going backwards.
+  if (!bBackwards) {
+    llBoards += revolveBoards(ptEnum, iCells - 1, iAtoms, 0);
+    ptEnum->paiComb[iAtoms - 1] = iCells - 1;
+    llBoards += revolveBoards(ptEnum, iCells - 1, iAtoms - 1, 1);
+  }
+  else {
+    ptEnum->paiComb[iAtoms - 1] = iCells - 1;
+    llBoards += revolveBoards(ptEnum, iCells - 1, iAtoms - 1, 0);
+    llBoards += revolveBoards(ptEnum, iCells - 1, iAtoms, 1);
+  }
+
+  return llBoards;
+}
+
+/*******************************************************************************
+ * Name:  enumerateBoards
+ * Purpose: Thread's work, takes the highest atom cell next in turn and visits
+ *          all boards below it, until all cells are taken.
+ *******************************************************************************/
+void* enumerateBoards(void* pvEnum) {
+  t_enumerator* ptEnum   = (t_enumerator*) pvEnum;
+  int           iAtomNo  = ptEnum->tBoard.iAtomNo;
+  int           iTop     = 0;
+  ll            llBoards = 0;
+
+  // Each thread takes a top cell at a time, the highest first, as they have
+  // the most boards below. The count is stored once at the end, as the
+  // threads' structs share cache lines.
+  while ((iTop = atomic_fetch_sub(ptEnum->piNextTop, 1)) >= iAtomNo - 1) {
+    ptEnum->paiComb[iAtomNo - 1] = iTop;
+    llBoards += revolveBoards(ptEnum, iTop, iAtomNo - 1, 0);
+  }
+
+  ptEnum->llBoards = llBoards;
+
+  return NULL;
+}
+
+/*******************************************************************************
+ * Name:  compareEnumKey
+ * Purpose: Compares two boards' hashes for qsort(), equal ones by their rows
+ *          in g_paucEnumRows, so colliding classes don't interleave, and
+ *          equal rows by rank.
+ *******************************************************************************/
+int compareEnumKey(const void* pvA, const void* pvB) {
+  const t_enumKey* ptA  = (const t_enumKey*) pvA;
+  const t_enumKey* ptB  = (const t_enumKey*) pvB;
+  int              iCmp = 0;
+
+  if (ptA->ullHash != ptB->ullHash)
+    return (ptA->ullHash > ptB->ullHash) ? 1 : -1;
+
+  iCmp = memcmp(&g_paucEnumRows[ptA->ullRank * (uint64_t) g_iEnumBeams],
+                &g_paucEnumRows[ptB->ullRank * (uint64_t) g_iEnumBeams], (size_t) g_iEnumBeams);
+  if (iCmp != 0)
+    return iCmp;
+
+  return (ptA->ullRank > ptB->ullRank) - (ptA->ullRank < ptB->ullRank);
+}
+
+/*******************************************************************************
+ * Name:  scoreProbes
+ * Purpose: Thread's work, counts for each beam not picked yet the groups its
+ *          rows split into by the beam's exit. The rows are read in order,
+ *          each once for all beams, the groups are told apart by a stamp.
+ *******************************************************************************/
+void* scoreProbes(void* pvProber) {
+  t_prober*      ptProber  = (t_prober*) pvProber;
+  int            iWidth    = ptProber->iWidth;
+  uint32_t*      pauiSeen  = ptProber->pauiSeen;
+  size_t*        pasGroups = ptProber->pasGroups;
+  uint32_t       uiStamp   = 0;
+  const uint8_t* paucRow   = NULL;
+
+  memset(pauiSeen,  0, sizeof(uint32_t) * (size_t) iWidth * 256);
+  memset(pasGroups, 0, sizeof(size_t) * (size_t) iWidth);
+
+  for (size_t g = ptProber->sFrom; g < ptProber->sTo; ++g) {
+    ++uiStamp;
+    for (size_t r = ptProber->pasStarts[g]; r < ptProber->pasStarts[g + 1]; ++r) {
+      paucRow = &ptProber->paucRows[r * (size_t) iWidth];
+
+      // Without a branch, as whether the exit is new is hard to predict.
+      for (int b = 0; b < iWidth; ++b) {
+        pasGroups[b] += (pauiSeen[b * 256 + paucRow[b]] != uiStamp);
+        pauiSeen[b * 256 + paucRow[b]] = uiStamp;
+      }
+    }
+  }
+
+  return NULL;
+}
+
+/*******************************************************************************
+ * Name:  pickProbes
+ * Purpose: Picks beams till they tell all distinct rows of exits apart, each
+ *          one splitting the rows not told apart yet into the most groups.
+ *          Fired in any order these beams tell apart all boards any beams
+ *          can, so their count is an upper bound of the probes needed. The
+ *          beams are scored over threads, the rows are overwritten. Writes
+ *          the beams into paiPicked and returns their count.
+ *******************************************************************************/
+int pickProbes(uint8_t* paucRows, size_t sRows, int iBeams, int iThreads, int* paiPicked) {
+  t_prober* patProbers = (t_prober*) calloc((size_t) iThreads, sizeof(t_prober));
+  uint8_t*  paucNext   = (uint8_t*)  malloc(sRows * (size_t) iBeams + 1);
+  size_t*   pasStarts  = (size_t*)   malloc(sizeof(size_t) * (sRows / 2 + 2));
+  size_t*   pasNext    = (size_t*)   malloc(sizeof(size_t) * (sRows / 2 + 2));
+  int*      paiOpen    = (int*)      malloc(sizeof(int) * (size_t) iBeams);
+  size_t    asCount[256] = {0};
+  size_t    asAt[256]    = {0};
+  uint8_t*  paucCur    = paucRows;
+  uint8_t*  paucSwap   = NULL;
+  size_t*   pasSwap    = NULL;
+  size_t    sGroups    = (sRows > 1) ? 1 : 0;
+  size_t    sKept      = 0;
+  size_t    sSplit     = 0;
+  size_t    sNew       = 0;
+  size_t    sBest      = 0;
+  size_t    sGroup     = 0;
+  int       iWidth     = iBeams;
+  int       iBest      = 0;
+  int       iPicked    = 0;
+  const uint8_t* paucRow = NULL;
+
+  if (paucNext == NULL || pasStarts == NULL || pasNext == NULL)
+    dispatchError(ERR_ELSE, "Can't allocate rows to pick probes");
+
+  pasStarts[0] = 0;
+  pasStarts[1] = sRows;
+  for (int b = 0; b < iBeams; ++b)
+    paiOpen[b] = b + 1;
+  for (int t = 0; t < iThreads; ++t) {
+    patProbers[t].pasStarts = pasStarts;
+    patProbers[t].pauiSeen  = (uint32_t*) malloc(sizeof(uint32_t) * (size_t) iBeams * 256);
+    patProbers[t].pasGroups = (size_t*)   malloc(sizeof(size_t) * (size_t) iBeams);
+  }
+
+  // Rows told apart from all others drop out, the rest is in groups of rows
+  // next to each other, alike in the beams picked, which drop out as well.
+  while (sGroups > 0) {
+    // Each thread takes about an even share of rows, in whole groups.
+    sGroup = 0;
+    for (int t = 0; t < iThreads; ++t) {
+      patProbers[t].paucRows  = paucCur;
+      patProbers[t].pasStarts = pasStarts;
+      patProbers[t].iWidth    = iWidth;
+      patProbers[t].sFrom     = sGroup;
+      while (sGroup < sGroups && (t == iThreads - 1 ||
+             pasStarts[sGroup] < pasStarts[sGroups] / (size_t) iThreads * (size_t) (t + 1)))
+        ++sGroup;
+      patProbers[t].sTo = sGroup;
+      if (pthread_create(&patProbers[t].tThread, NULL, scoreProbes, &patProbers[t]) != 0)
+        dispatchError(ERR_ELSE, "Can't create thread");
+    }
+    for (int t = 0; t < iThreads; ++t)
+      pthread_join(patProbers[t].tThread, NULL);
+
+    iBest = 0;
+    sBest = 0;
+    for (int b = 0; b < iWidth; ++b) {
+      sSplit = 0;
+      for (int t = 0; t < iThreads; ++t)
+        sSplit += patProbers[t].pasGroups[b];
+      if (sSplit > sBest) {
+        sBest = sSplit;
+        iBest = b;
+      }
+    }
+
+    // Rows differ in some beam not picked yet, so there is always one.
+    paiPicked[iPicked++] = paiOpen[iBest];
+    memmove(&paiOpen[iBest], &paiOpen[iBest + 1], sizeof(int) * (size_t) (iWidth - iBest - 1));
+
+    // Each group's rows sorted by the exit into new groups, without the
+    // beam's byte, groups of one are told apart.
+    sKept = 0;
+    sNew  = 0;
+    for (size_t g = 0; g < sGroups; ++g) {
+      for (size_t r = pasStarts[g]; r < pasStarts[g + 1]; ++r)
+        ++asCount[paucCur[r * (size_t) iWidth + (size_t) iBest]];
+      for (size_t r = pasStarts[g]; r < pasStarts[g + 1]; ++r) {
+        uint8_t ucExit = paucCur[r * (size_t) iWidth + (size_t) iBest];
+
+        if (asCount[ucExit] > 1) {
+          pasNext[sNew++]   = sKept;
+          asAt[ucExit]      = sKept;
+          sKept            += asCount[ucExit];
+          asCount[ucExit]   = 0;
+        }
+      }
+      for (size_t r = pasStarts[g]; r < pasStarts[g + 1]; ++r) {
+        paucRow = &paucCur[r * (size_t) iWidth];
+        if (asCount[paucRow[iBest]] == 1) {
+          asCount[paucRow[iBest]] = 0;
+          continue;
+        }
+        uint8_t* paucTo = &paucNext[asAt[paucRow[iBest]]++ * (size_t) (iWidth - 1)];
+        memcpy(paucTo, paucRow, (size_t) iBest);
+        memcpy(paucTo + iBest, paucRow + iBest + 1, (size_t) (iWidth - iBest - 1));
+      }
+    }
+    pasNext[sNew] = sKept;
+
+    --iWidth;
+    sGroups   = sNew;
+    pasSwap   = pasStarts;
+    pasStarts = pasNext;
+    pasNext   = pasSwap;
+    paucSwap  = paucCur;
+    paucCur   = paucNext;
+    paucNext  = paucSwap;
+  }
+
+  for (int t = 0; t < iThreads; ++t) {
+    free(patProbers[t].pauiSeen);
+    free(patProbers[t].pasGroups);
+  }
+  free(patProbers);
+  free((paucCur == paucRows) ? paucNext : paucCur);
+  free(pasStarts);
+  free(pasNext);
+  free(paiOpen);
+
+  return iPicked;
+}
+
+/*******************************************************************************
+ * Name:  runEnumeration
+ * Purpose: Fires all beams into every board, spread over threads, writes the
+ *          exits into a mapped table and sums up boards no beams tell apart.
+ *          With '--symmetry' just canonical boards are walked, the rows of
+ *          their images are mapped, and each class of rows counts for all
+ *          images of it.
+ *******************************************************************************/
+void runEnumeration(const char* pcFile) {
+  int           iSize     = g_tOpts.iSize;
+  int           iAtomNo   = g_tOpts.iAtomNo;
+  int           iCells    = iSize * iSize;
+  int           iBeams    = 4 * iSize;
+  int           iThreads  = g_tOpts.iThreads;
+  ll            llBoards  = 0;
+  size_t        sBytes    = 0;
+  FILE*         hFile     = NULL;
+  uint8_t*      paucMap   = NULL;
+  t_enumHead*   ptHead    = NULL;
+  t_enumKey*    patKeys   = NULL;
+  size_t        sKeys     = 0;
+  ll*           pallBinom = NULL;
+  int*          paiSymEdges = NULL;
+  int*          paiSymCells = NULL;
+  t_enumerator* patEnum   = NULL;
+  atomic_int    iNextTop  = iCells - 1;
+  struct timespec tStart  = {0};
+  struct timespec tEnd    = {0};
+  ll            llClasses = 0;
+  ll            llUnique  = 0;
+  ll            llLargest = 0;
+  ll            llClass   = 0;
+  ll            llSquares = 0;
+  ll            llVisited = 0;
+  ll            llWalked  = 0;
+  ll            llRows    = 0;
+  double        dSeconds  = 0.0;
+  double        dPicking  = 0.0;
+  uint8_t*      paucDistinct = NULL;
+  uint8_t*      paucImage = NULL;
+  const uint8_t* paucRow  = NULL;
+  size_t        sDistinct = 0;
+  size_t        sRoom     = 0;
+  size_t        sFirst    = 0;
+  int*          paiPicked = NULL;
+  int           iPicked   = 0;
+  int           bNew      = 0;
+
+  // Size first, binomial() saturates then, so the count is never garbage.
+  if (iSize > ENUM_MAX_SIZE)
+    dispatchError(ERR_ARGS, "Board too large to enumerate");
+  llBoards = binomial(iCells, iAtomNo);
+  if (llBoards <= 0 || llBoards > ENUM_MAX_BOARDS)
+    dispatchError(ERR_ARGS, "Too many boards to enumerate");
+
+  if (g_tOpts.bSymmetry) {
+    paiSymEdges = createSymmetryTable(iSize);
+    paiSymCells = createSymmetryCells(iSize);
+  }
+
+  // Table of c choose i, to rank the boards.
+  pallBinom = (ll*) malloc(sizeof(ll) * (size_t) (iCells * (iAtomNo + 1)));
+  for (int c = 0; c < iCells; ++c)
+    for (int i = 0; i <= iAtomNo; ++i)
+      pallBinom[c * (iAtomNo + 1) + i] = binomial(c, i);
+
+  // The table is mapped, so threads write their rows straight into the file.
+  sBytes = sizeof(t_enumHead) + (size_t) llBoards * (size_t) iBeams;
+  hFile  = openFile(pcFile, "w+b");
+  if (ftruncate(fileno(hFile), (off_t) sBytes) != 0)
+    dispatchError(ERR_FILE, "Can't size table");
+  paucMap = (uint8_t*) mmap(NULL, sBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fileno(hFile), 0);
+  if (paucMap == MAP_FAILED)
+    dispatchError(ERR_FILE, "Can't map table");
+
+  ptHead            = (t_enumHead*) paucMap;
+  ptHead->uiMagic   = ENUM_MAGIC;
+  ptHead->uiSize    = (uint32_t) iSize;
+  ptHead->uiAtomNo  = (uint32_t) iAtomNo;
+  ptHead->uiBeams   = (uint32_t) iBeams;
+  ptHead->ullBoards = (uint64_t) llBoards;
+
+  patEnum = (t_enumerator*) calloc((size_t) iThreads, sizeof(t_enumerator));
+
+  clock_gettime(CLOCK_MONOTONIC, &tStart);
+
+  for (int t = 0; t < iThreads; ++t) {
+    initBoard(&patEnum[t].tBoard, iSize, iAtomNo, g_tOpts.bBitboard);
+    initBeamCache(&patEnum[t].tCache, &patEnum[t].tBoard);
+    patEnum[t].piNextTop = &iNextTop;
+    patEnum[t].paiComb   = (int*)  calloc((size_t) iAtomNo + 1, sizeof(int));
+    patEnum[t].paiPrev   = (int*)  malloc(sizeof(int) * ((size_t) iAtomNo + 1));
+    patEnum[t].pacIn     = (char*) calloc((size_t) iCells, sizeof(char));
+    patEnum[t].pallBinom = pallBinom;
+    patEnum[t].paucTable = paucMap + sizeof(t_enumHead);
+    patEnum[t].paiSymEdges = paiSymEdges;
+    patEnum[t].paiSymCells = paiSymCells;
+    patEnum[t].paiImage  = (int*)     malloc(sizeof(int) * ((size_t) iAtomNo + 1));
+    patEnum[t].paucRows  = (uint8_t*) malloc((size_t) (SYM_COUNT * iBeams));
+    daInit(t_enumKey, patEnum[t].tKeys);
+    for (int i = 0; i <= iAtomNo; ++i)
+      patEnum[t].paiPrev[i] = -1;
+  }
+
+  // Without atoms there is just the empty board.
+  if (iAtomNo == 0) {
+    visitBoard(&patEnum[0]);
+    patEnum[0].llBoards = 1;
+  }
+  else
+    for (int t = 0; t < iThreads; ++t)
+      if (pthread_create(&patEnum[t].tThread, NULL, enumerateBoards, &patEnum[t]) != 0)
+        dispatchError(ERR_ELSE, "Can't create thread");
+
+  for (int t = 0; t < iThreads; ++t) {
+    if (iAtomNo != 0)
+      pthread_join(patEnum[t].tThread, NULL);
+    llVisited += patEnum[t].llBoards;
+    llWalked  += patEnum[t].llWalked;
+    sKeys     += patEnum[t].tKeys.sCount;
+    freeBeamCache(&patEnum[t].tCache);
+    freeBoard(&patEnum[t].tBoard);
+    free(patEnum[t].paiComb);
+    free(patEnum[t].paiPrev);
+    free(patEnum[t].pacIn);
+    free(patEnum[t].paiImage);
+    free(patEnum[t].paucRows);
+  }
+
+  // Threads' keys into one list.
+  patKeys = (t_enumKey*) malloc(sizeof(t_enumKey) * (sKeys + 1));
+  sKeys   = 0;
+  for (int t = 0; t < iThreads; ++t) {
+    memcpy(&patKeys[sKeys], patEnum[t].tKeys.pVal, sizeof(t_enumKey) * patEnum[t].tKeys.sCount);
+    sKeys += patEnum[t].tKeys.sCount;
+    daFree(patEnum[t].tKeys);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &tEnd);
+  dSeconds = (double) (tEnd.tv_sec - tStart.tv_sec) + (double) (tEnd.tv_nsec - tStart.tv_nsec) / 1e9;
+
+  // Boards with equal exits are next to each other after sorting by hash.
+  // Hashes may collide, so rows of equal hash are sorted by their bytes and
+  // each row is compared to its class's first, too.
+  g_paucEnumRows = paucMap + sizeof(t_enumHead);
+  g_iEnumBeams   = iBeams;
+  qsort(patKeys, sKeys, sizeof(t_enumKey), compareEnumKey);
+  for (size_t i = 0, j = 0; i < sKeys; i = j) {
+    llClass = 0;
+    for (j = i; j < sKeys && patKeys[j].ullHash == patKeys[i].ullHash &&
+                memcmp(&paucMap[sizeof(t_enumHead) + patKeys[i].ullRank * (uint64_t) iBeams],
+                       &paucMap[sizeof(t_enumHead) + patKeys[j].ullRank * (uint64_t) iBeams],
+                       (size_t) iBeams) == 0; ++j)
+      llClass += patKeys[j].uiBoards;
+
+    // The boards of a class of rows spread evenly over its images, as each
+    // symmetry maps the boards of one row onto those of its image.
+    llRows   = patKeys[i].uiRows;
+    llClass /= llRows;
+
+    llClasses += llRows;
+    llSquares += llRows * llClass * llClass;
+
+    // Each distinct image of the row is a class of its own, its row is put
+    // next to the others for pickProbes().
+    paucRow = &paucMap[sizeof(t_enumHead) + patKeys[i].ullRank * (uint64_t) iBeams];
+    sFirst  = sDistinct;
+    for (int iSym = 0; iSym < SYM_COUNT && (iSym == 0 || paiSymEdges != NULL); ++iSym) {
+      if ((sDistinct + 1) * (size_t) iBeams > sRoom) {
+        sRoom        = 2 * sRoom + (size_t) (SYM_COUNT * iBeams);
+        paucDistinct = (uint8_t*) realloc(paucDistinct, sRoom);
+        if (paucDistinct == NULL)
+          dispatchError(ERR_ELSE, "Can't allocate rows to pick probes");
+      }
+
+      // Beam entering at the image of an edge exits at the image of its exit.
+      paucImage = &paucDistinct[sDistinct * (size_t) iBeams];
+      if (iSym == 0)
+        memcpy(paucImage, paucRow, (size_t) iBeams);
+      else
+        for (int iBeam = 1; iBeam <= iBeams; ++iBeam)
+          paucImage[paiSymEdges[iSym * (iBeams + 1) + iBeam] - 1] =
+            (uint8_t) paiSymEdges[iSym * (iBeams + 1) + paucRow[iBeam - 1]];
+      bNew = 1;
+      for (size_t k = sFirst; k < sDistinct && bNew; ++k)
+        bNew = (memcmp(&paucDistinct[k * (size_t) iBeams], paucImage, (size_t) iBeams) != 0);
+      if (bNew)
+        ++sDistinct;
+    }
+    if (llClass == 1)
+      llUnique += llRows;
+    if (llClass > llLargest)
+      llLargest = llClass;
+  }
+
+  printf("# boards of size %d with %d atoms, threads %d, table '%s'\n", iSize, iAtomNo, iThreads, pcFile);
+  printf("boards %lld\n", llVisited);
+  if (paiSymEdges != NULL)
+    printf("canonical %lld\n", llWalked);
+  printf("classes %lld\n", llClasses);
+  printf("told_apart %lld\n", llUnique);
+  printf("largest_class %lld\n", llLargest);
+  printf("mean_class %.3f\n", (double) llSquares / (double) llBoards);
+  printf("# %.3f s = %.0f boards/s\n", dSeconds, (double) llVisited / dSeconds);
+
+  // Beams telling apart all boards which can be, read back from the table.
+  clock_gettime(CLOCK_MONOTONIC, &tStart);
+  paiPicked = (int*) malloc(sizeof(int) * (size_t) (iBeams + 1));
+  iPicked   = pickProbes(paucDistinct, sDistinct, iBeams, iThreads, paiPicked);
+  clock_gettime(CLOCK_MONOTONIC, &tEnd);
+  dPicking = (double) (tEnd.tv_sec - tStart.tv_sec) + (double) (tEnd.tv_nsec - tStart.tv_nsec) / 1e9;
+
+  printf("probes_needed %d\n", iPicked);
+  printf("# beams");
+  for (int p = 0; p < iPicked; ++p)
+    printf(" %d", paiPicked[p]);
+  printf(", picked in %.3f s\n", dPicking);
+
+  munmap(paucMap, sBytes);
+  fclose(hFile);
+  free(patKeys);
+  free(patEnum);
+  free(pallBinom);
+  free(paucDistinct);
+  free(paiPicked);
+  free(paiSymEdges);
+  free(paiSymCells);
+}
+
+/*******************************************************************************
+ * Name:  startSession
+ * Purpose: Sets up a new game for a session and greets the player.
+ *******************************************************************************/
+void startSession(t_session* ptSes, t_rand* ptRand) {
+  t_rand tRand = {0};
 
-  // Infinit loop, will stop via return;
-  while (1) {
-    iAtom = lookAhead(iCell, iDirection);
+  // Each board has its own seed, so a record tells how to play it again.
+  ptSes->llSeed = (ll) (randNext(ptRand) >> 1);
+  randSeed(&tRand, (uint64_t) ptSes->llSeed);
 
-    // Beam was absorbed by an atom, done!
-    if (iAtom == ATOM_CENTER) return 0;
+  initBoard(&ptSes->tBoard, g_tOpts.iSize, g_tOpts.iAtomNo, g_tOpts.bBitboard);
+  createBoard(&ptSes->tBoard, &tRand);
+  createExitTable(&ptSes->tBoard);
+  initScorer(&ptSes->tScorer, &g_tOpts.atRules[0]);
+  startScore(&ptSes->tScorer, g_tOpts.iSize);
+  ptSes->iAnswered = -1;
 
-    // Turn as long as atoms are on front sides.
-    while (iAtom == ATOM_LEFT || iAtom == ATOM_RIGHT) {
-      iDirection =  turnBeam(iAtom, iDirection);
-      iAtom      = lookAhead(iCell, iDirection);
-      // Still at border? Done!
-      if (g_paiGrid[iCell] == CELL_BORDER) return iCell;
+  // Beams and guesses are kept for the record only.
+  if (g_hRecord != NULL) {
+    daInit(t_probe, ptSes->tProbes);
+    ptSes->paiGuesses = (int*) malloc(sizeof(int) * (size_t) (g_tOpts.iAtomNo + 1));
+  }
+
+  renderBoard(&ptSes->tBoard, BOARD_NEUTRAL, NULL, &ptSes->csOut);
+  csAppend(&ptSes->csOut, "Enter beam 's entry number: ");
+}
+
+/*******************************************************************************
+ * Name:  endSession
+ * Purpose: Shows the solution and score once all atoms are answered, records
+ *          the game and closes the session.
+ *******************************************************************************/
+void endSession(t_session* ptSes) {
+  t_board* ptBoard = &ptSes->tBoard;
+
+  endScore(&ptSes->tScorer, ptBoard->iAtomNo);
+  renderBoard(ptBoard, BOARD_SOLUTION, NULL, &ptSes->csOut);
+  renderScore(ptSes->tScorer.ptRules, &ptSes->tScorer.tScore, &ptSes->csOut);
+  if (g_hRecord != NULL)
+    writeRecord(g_hRecord, ptSes->llSeed, ptBoard, ptSes->tProbes.pVal, (int) ptSes->tProbes.sCount,
+                ptSes->paiGuesses, ptSes->iAnswered, &ptSes->tScorer.tScore);
+  ptSes->bClose = 1;
+}
+
+/*******************************************************************************
+ * Name:  playSessionLine
+ * Purpose: Plays one input line of a session, like the prompt of main() does.
+ *******************************************************************************/
+void playSessionLine(t_session* ptSes, const char* pcLine) {
+  t_board* ptBoard    = &ptSes->tBoard;
+  cstr*    pcsOut     = &ptSes->csOut;
+  int      iNodeEntry = 0;
+  int      iNodeExit  = 0;
+  int      iCell      = 0;
+  int      iX         = 0;
+  int      iY         = 0;
+  t_probe  tProbe     = {0};
+
+  // Answering where the atoms are.
+  if (ptSes->iAnswered >= 0) {
+    if (sscanf(pcLine, "%20d %20d", &iY, &iX) != 2 ||
+        iY < 1 || iY > ptBoard->iSize ||
+        iX < 1 || iX > ptBoard->iSize) {
+      csAppend(pcsOut, "A coordinate is out of range, try again.\n");
+    }
+    else {
+      csAppendf(pcsOut, "you entered down %i and right %i\n", iY, iX);
+      cellFromXY(ptBoard, &iCell, iX, iY);
+      if (ptSes->paiGuesses != NULL)
+        ptSes->paiGuesses[ptSes->iAnswered] = iCell;
+      if (ptBoard->paiGrid[iCell] == CELL_ATOM) {
+        csAppend(pcsOut, "Atom Found\n\n");
+      }
+      else {
+        csAppend(pcsOut, "Atom not found\n\n");
+      }
+      scoreGuess(&ptSes->tScorer, (iY - 1) * ptBoard->iSize + iX - 1, ptBoard->paiGrid[iCell] == CELL_ATOM);
+      ++ptSes->iAnswered;
     }
 
-    // A step ahead without an atom in the way.
-    iCell = goAhead(iCell, iDirection);
+    // All atoms answered, game over.
+    if (ptSes->iAnswered == ptBoard->iAtomNo) {
+      endSession(ptSes);
+      return;
+    }
 
-    // At border again? Done!
-    if (g_paiGrid[iCell] == CELL_BORDER) return iCell;
+    csAppendf(pcsOut, "Atom %d of %d, y x: ", ptSes->iAnswered + 1, ptBoard->iAtomNo);
+    return;
+  }
+
+  if (pcLine[0] == '\0') {
+    csAppend(pcsOut, "Not a number or command ...\n");
+  }
+  else if (pcLine[0] == 'e' || pcLine[0] == 'E' ||
+           pcLine[0] == 'f' || pcLine[0] == 'F') {
+    csAppendf(pcsOut, "\nEnter coordinates of each Atom as "
+                      "y (down) and x (right) (each from 1 to %d)\n\n",
+              ptBoard->iSize);
+    ptSes->iAnswered = 0;
+    if (ptBoard->iAtomNo == 0)
+      endSession(ptSes);
+    else
+      csAppendf(pcsOut, "Atom 1 of %d, y x: ", ptBoard->iAtomNo);
+    return;
+  }
+  else if (pcLine[0] == 'q' || pcLine[0] == 'Q') {
+    csAppend(pcsOut, "Bye then ...\n");
+    ptSes->bClose = 1;
+    return;
+  }
+  else if (pcLine[0] == 'b' || pcLine[0] == 'B') {
+    renderBoard(ptBoard, BOARD_NEUTRAL, NULL, pcsOut);
+  }
+  else {
+    iNodeEntry = (int) strtol(pcLine, NULL, 10);
+
+    if (iNodeEntry < 1 || iNodeEntry > 4 * ptBoard->iSize) {
+      csAppend(pcsOut, "Beam out of bounds ...\n");
+    }
+    else {
+      iNodeExit = ptBoard->paiExits[iNodeEntry];
+
+      if (g_hRecord != NULL) {
+        tProbe.iEntry = iNodeEntry;
+        tProbe.iExit  = iNodeExit;
+        daAdd(t_probe, ptSes->tProbes, tProbe);
+      }
+      scoreBeam(&ptSes->tScorer, iNodeEntry, iNodeExit);
+
+      if (iNodeExit == iNodeEntry)
+        csAppend(pcsOut, "Beam was reflected\n");
+      else if (iNodeExit == 0)
+        csAppend(pcsOut, "Beam was absorbed\n");
+      else
+        csAppendf(pcsOut, "Beam exited at %d\n", iNodeExit);
+    }
   }
+
+  csAppend(pcsOut, "\nEnter beam 's entry number: ");
 }
 
 /*******************************************************************************
- * Name:  getAtomAnswers
- * Purpose: Retrieves atom guesses from user and prints if entered correctly.
+ * Name:  flushSession
+ * Purpose: Sends as much output as the socket takes. Returns 0 if the session
+ *          is to be closed.
  *******************************************************************************/
-void getAtomAnswers(void) {
-  int  iCell = 0;
-  int  iX    = 0;
-  int  iY    = 0;
+int flushSession(t_session* ptSes, int iEpoll) {
+  struct epoll_event tEvent = {0};
+  ssize_t            sSent  = 0;
 
-  printf("\n");
-  printf("Enter coordinates of each Atom as "
-         "y (down) and x (right) (each from 1 to %d)\n\n",
-         g_tOpts.iSize);
+  while (ptSes->llSent < ptSes->csOut.len) {
+    sSent = send(ptSes->iFd, ptSes->csOut.cStr + ptSes->llSent,
+                 (size_t) (ptSes->csOut.len - ptSes->llSent), MSG_NOSIGNAL);
+    if (sSent < 0 && errno == EINTR)
+      continue;
+    if (sSent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+    if (sSent < 0)
+      return 0;
+    ptSes->llSent += sSent;
+  }
 
-  for (int i = 0; i < g_tOpts.iAtomNo; ++i) {
-    printf("Atom %d of %d\n", i + 1, g_tOpts.iAtomNo);
-    printf("y: "); scanf("%20d", &iY);
-    printf("x: "); scanf("%20d", &iX);
+  // All sent, reuse output buffer.
+  if (ptSes->llSent == ptSes->csOut.len) {
+    csReset(&ptSes->csOut);
+    ptSes->llSent = 0;
+    if (ptSes->bClose)
+      return 0;
+  }
 
-    // Range check.
-    if (iY< 1 || iY > g_tOpts.iSize ||
-        iX< 1 || iX > g_tOpts.iSize) {
-      printf("A coordinate is out of range, try again.\n");
-      --i;
+  // Only wake up on a writable socket while output is pending.
+  if (ptSes->bWaitOut != (ptSes->llSent < ptSes->csOut.len)) {
+    ptSes->bWaitOut  = !ptSes->bWaitOut;
+    tEvent.events    = EPOLLIN | (ptSes->bWaitOut ? EPOLLOUT : 0);
+    tEvent.data.ptr  = ptSes;
+    epoll_ctl(iEpoll, EPOLL_CTL_MOD, ptSes->iFd, &tEvent);
+  }
+
+  return 1;
+}
+
+/*******************************************************************************
+ * Name:  readSession
+ * Purpose: Reads all input there is and plays each complete line. Returns 0 if
+ *          the session is to be closed.
+ *******************************************************************************/
+int readSession(t_session* ptSes) {
+  char    acBuf[SERVE_READ];
+  ssize_t sRead = 0;
+
+  while (!ptSes->bClose) {
+    sRead = read(ptSes->iFd, acBuf, sizeof(acBuf));
+    if (sRead < 0 && errno == EINTR)
       continue;
+    if (sRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return 1;
+    if (sRead <= 0)
+      return 0;
+
+    for (ssize_t i = 0; i < sRead && !ptSes->bClose; ++i) {
+      if (acBuf[i] == '\n') {
+        playSessionLine(ptSes, ptSes->csIn.cStr);
+        csReset(&ptSes->csIn);
+        continue;
+      }
+      if (acBuf[i] == '\r')
+        continue;
+
+      // Nobody types that much, so it's no player.
+      if (ptSes->csIn.len >= SERVE_MAX_LINE)
+        return 0;
+      csPushChar(&ptSes->csIn, acBuf[i]);
     }
+  }
 
-    printf("you entered down %i and right %i\n", iY, iX);
+  return 1;
+}
 
-    cellFromXY(&iCell, iX, iY);
+/*******************************************************************************
+ * Name:  closeSession
+ * Purpose: Closes session's connection and frees all of its memory.
+ *******************************************************************************/
+void closeSession(t_session* ptSes) {
+  close(ptSes->iFd);
+  freeBoard(&ptSes->tBoard);
+  freeScorer(&ptSes->tScorer);
+  csFree(&ptSes->csIn);
+  csFree(&ptSes->csOut);
+  if (g_hRecord != NULL)
+    daFree(ptSes->tProbes);
+  free(ptSes->paiGuesses);
+  free(ptSes);
+}
 
-    if (g_paiGrid[iCell] == CELL_ATOM) {
-      printf("Atom Found\n");
+/*******************************************************************************
+ * Name:  openListener
+ * Purpose: Opens a socket listening on a TCP port, or on a Unix socket path,
+ *          if pcAddr is no number.
+ *******************************************************************************/
+int openListener(const char* pcAddr) {
+  struct sockaddr_in tIn    = {0};
+  struct sockaddr_un tUn    = {0};
+  char*              pcEnd  = NULL;
+  long               lPort  = strtol(pcAddr, &pcEnd, 10);
+  int                iFd    = -1;
+  int                iOn    = 1;
+  int                iRv    = 0;
+
+  if (*pcAddr != '\0' && *pcEnd == '\0') {
+    if (lPort < 1 || lPort > 65535)
+      dispatchError(ERR_ARGS, "Port must be from 1 to 65535");
+    iFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (iFd < 0)
+      dispatchError(ERR_ELSE, "Can't create socket");
+    setsockopt(iFd, SOL_SOCKET, SO_REUSEADDR, &iOn, sizeof(iOn));
+    tIn.sin_family      = AF_INET;
+    tIn.sin_addr.s_addr = htonl(INADDR_ANY);
+    tIn.sin_port        = htons((uint16_t) lPort);
+    iRv = bind(iFd, (struct sockaddr*) &tIn, sizeof(tIn));
+  }
+  else {
+    if (strlen(pcAddr) >= sizeof(tUn.sun_path))
+      dispatchError(ERR_ARGS, "Socket path too long");
+    iFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (iFd < 0)
+      dispatchError(ERR_ELSE, "Can't create socket");
+    tUn.sun_family = AF_UNIX;
+    strcpy(tUn.sun_path, pcAddr);
+    unlink(pcAddr);
+    iRv = bind(iFd, (struct sockaddr*) &tUn, sizeof(tUn));
+  }
+
+  if (iRv < 0 || listen(iFd, SERVE_BACKLOG) < 0)
+    dispatchError(ERR_ELSE, "Can't listen on given port or path");
+
+  return iFd;
+}
+
+/*******************************************************************************
+ * Name:  queueInit
+ * Purpose: Allocates an empty queue.
+ *******************************************************************************/
+void queueInit(t_queue* ptQueue) {
+  ptQueue->patRing = (t_request*) malloc(sizeof(t_request) * SERVE_QUEUE);
+  atomic_init(&ptQueue->sHead, 0);
+  atomic_init(&ptQueue->sTail, 0);
+}
+
+/*******************************************************************************
+ * Name:  queuePush
+ * Purpose: Pushes a request, only called by the producer. Returns 0 if full.
+ *******************************************************************************/
+int queuePush(t_queue* ptQueue, const t_request* ptReq) {
+  size_t sTail = atomic_load_explicit(&ptQueue->sTail, memory_order_relaxed);
+  size_t sHead = atomic_load_explicit(&ptQueue->sHead, memory_order_acquire);
+
+  if (sTail - sHead == SERVE_QUEUE)
+    return 0;
+
+  // Publish the request, before the consumer sees the new tail.
+  ptQueue->patRing[sTail & (SERVE_QUEUE - 1)] = *ptReq;
+  atomic_store_explicit(&ptQueue->sTail, sTail + 1, memory_order_release);
+
+  return 1;
+}
+
+/*******************************************************************************
+ * Name:  queuePop
+ * Purpose: Pops a request, only called by the consumer. Returns 0 if empty.
+ *******************************************************************************/
+int queuePop(t_queue* ptQueue, t_request* ptReq) {
+  size_t sHead = atomic_load_explicit(&ptQueue->sHead, memory_order_relaxed);
+  size_t sTail = atomic_load_explicit(&ptQueue->sTail, memory_order_acquire);
+
+  if (sHead == sTail)
+    return 0;
+
+  // Take the request, before the producer may overwrite its slot.
+  *ptReq = ptQueue->patRing[sHead & (SERVE_QUEUE - 1)];
+  atomic_store_explicit(&ptQueue->sHead, sHead + 1, memory_order_release);
+
+  return 1;
+}
+
+/*******************************************************************************
+ * Name:  wakeShard
+ * Purpose: Wakes shard up to take its requests.
+ *******************************************************************************/
+void wakeShard(t_shard* ptShard) {
+  uint64_t ullOne = 1;
+
+  if (write(ptShard->iWake, &ullOne, sizeof(ullOne)) < 0 && errno != EAGAIN)
+    dispatchError(ERR_ELSE, "Can't wake up shard");
+}
+
+/*******************************************************************************
+ * Name:  pushRequest
+ * Purpose: Hands a request over to the shard owning it, waits while full.
+ *******************************************************************************/
+void pushRequest(t_shard* ptShard, int iQueue, const t_request* ptReq) {
+  while (!queuePush(&ptShard->patQueues[iQueue], ptReq)) {
+    wakeShard(ptShard);
+    sched_yield();
+  }
+}
+
+/*******************************************************************************
+ * Name:  takeRequest
+ * Purpose: Takes over a connection or fires a load session's beam. Returns 0 on
+ *          a stop request.
+ *******************************************************************************/
+int takeRequest(t_shard* ptShard, const t_request* ptReq, t_probeCounts* ptCounts) {
+  struct epoll_event tEvent  = {0};
+  t_session*         ptSes   = NULL;
+  int                iExit   = 0;
+
+  if (ptReq->iFd == REQ_STOP)
+    return 0;
+
+  if (ptReq->iFd == REQ_PROBE) {
+    iExit = ptShard->patBoards[ptReq->iSession].paiExits[ptReq->iEntry];
+    ++ptCounts->llProbes;
+    if (iExit == 0)                   ++ptCounts->llAbsorbed;
+    else if (iExit == ptReq->iEntry)  ++ptCounts->llReflected;
+    return 1;
+  }
+
+  ptSes        = (t_session*) calloc(1, sizeof(t_session));
+  ptSes->iFd   = ptReq->iFd;
+  ptSes->csIn  = csNew("");
+  ptSes->csOut = csNew("");
+  tEvent.events   = EPOLLIN;
+  tEvent.data.ptr = ptSes;
+  epoll_ctl(ptShard->iEpoll, EPOLL_CTL_ADD, ptSes->iFd, &tEvent);
+  startSession(ptSes, &ptShard->tRand);
+  if (!flushSession(ptSes, ptShard->iEpoll))
+    closeSession(ptSes);
+
+  return 1;
+}
+
+/*******************************************************************************
+ * Name:  runShard
+ * Purpose: Thread's work, serves its sessions and takes its requests till it is
+ *          stopped. Sessions are multiplexed with epoll, so idle ones cost
+ *          nothing but their memory.
+ *******************************************************************************/
+void* runShard(void* pvShard) {
+  t_shard*           ptShard = (t_shard*) pvShard;
+  struct epoll_event atEvents[SERVE_EVENTS];
+  t_session*         ptSes   = NULL;
+  t_request          tReq    = {0};
+  t_probeCounts      tCounts = {0};
+  uint64_t           ullWake = 0;
+  int                iEvents = 0;
+  int                bOpen   = 0;
+  int                bRun    = 1;
+
+  while (bRun) {
+    iEvents = epoll_wait(ptShard->iEpoll, atEvents, SERVE_EVENTS, -1);
+    if (iEvents < 0 && errno == EINTR)
+      continue;
+    if (iEvents < 0)
+      dispatchError(ERR_ELSE, "epoll_wait() failed");
+
+    for (int e = 0; e < iEvents; ++e) {
+      ptSes = (t_session*) atEvents[e].data.ptr;
+
+      // Woken up, requests are taken below.
+      if (ptSes == NULL) {
+        if (read(ptShard->iWake, &ullWake, sizeof(ullWake)) < 0 && errno != EAGAIN)
+          dispatchError(ERR_ELSE, "Can't read shard's wake up");
+        continue;
+      }
+
+      bOpen = 1;
+      if (atEvents[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+        bOpen = readSession(ptSes);
+      if (bOpen)
+        bOpen = flushSession(ptSes, ptShard->iEpoll);
+      if (!bOpen)
+        closeSession(ptSes);
     }
-    else {
-      printf("Atom not found\n");
-      ++g_tScore.iMissedAtoms;
+
+    // A stop comes after all requests of all producers, so take them all.
+    for (int q = 0; q < ptShard->iQueues; ++q)
+      while (queuePop(&ptShard->patQueues[q], &tReq))
+        bRun &= takeRequest(ptShard, &tReq, &tCounts);
+  }
+
+  ptShard->tCounts = tCounts;
+
+  return NULL;
+}
+
+/*******************************************************************************
+ * Name:  startShards
+ * Purpose: Starts one shard per thread, each with a queue per producer and its
+ *          share of load sessions, session s belongs to shard s % iShards.
+ *******************************************************************************/
+t_shard* startShards(int iShards, int iProducers, int iLoadSessions, t_rand* ptRand) {
+  t_shard*           patShards = (t_shard*) calloc((size_t) iShards, sizeof(t_shard));
+  struct epoll_event tEvent    = {0};
+
+  for (int t = 0; t < iShards; ++t) {
+    patShards[t].iEpoll = epoll_create1(0);
+    patShards[t].iWake  = eventfd(0, EFD_NONBLOCK);
+    if (patShards[t].iEpoll < 0 || patShards[t].iWake < 0)
+      dispatchError(ERR_ELSE, "Can't create epoll instance or eventfd");
+
+    // The wake up is the only event without session.
+    tEvent.events   = EPOLLIN;
+    tEvent.data.ptr = NULL;
+    epoll_ctl(patShards[t].iEpoll, EPOLL_CTL_ADD, patShards[t].iWake, &tEvent);
+
+    patShards[t].iQueues   = iProducers;
+    patShards[t].patQueues = (t_queue*) calloc((size_t) iProducers, sizeof(t_queue));
+    for (int q = 0; q < iProducers; ++q)
+      queueInit(&patShards[t].patQueues[q]);
+
+    patShards[t].tRand = *ptRand;
+    randJump(ptRand);
+
+    patShards[t].iSessions = (iLoadSessions - t + iShards - 1) / iShards;
+    patShards[t].patBoards = (t_board*) calloc((size_t) patShards[t].iSessions + 1, sizeof(t_board));
+    for (int i = 0; i < patShards[t].iSessions; ++i) {
+      initBoard(&patShards[t].patBoards[i], g_tOpts.iSize, g_tOpts.iAtomNo, g_tOpts.bBitboard);
+      createBoard(&patShards[t].patBoards[i], &patShards[t].tRand);
+      createExitTable(&patShards[t].patBoards[i]);
     }
-    printf("\n");
+
+    if (pthread_create(&patShards[t].tThread, NULL, runShard, &patShards[t]) != 0)
+      dispatchError(ERR_ELSE, "Can't create thread");
   }
+
+  return patShards;
 }
 
 /*******************************************************************************
- * Name:  printScore
- * Purpose: Prints final score.
+ * Name:  stopShards
+ * Purpose: Stops all shards after their requests and frees their memory.
  *******************************************************************************/
-void printScore(void) {
-  printf("Final score:\n");
-  printf("-------------\n");
-  printf("Missed Atoms    %3d x %3d = %3d\n",
-         g_tScore.iMissedAtoms,
-         SCORE_ATOM,
-         SCORE_ATOM * g_tScore.iMissedAtoms);
-  printf("Exited beams    %3d x %3d = %3d\n",
-         g_tScore.iExited,
-         SCORE_EXIT,
-         SCORE_EXIT * g_tScore.iExited);
-  printf("Reflected beams %3d x %3d = %3d\n",
-         g_tScore.iReflected,
-         SCORE_REFLECTED,
-         SCORE_REFLECTED * g_tScore.iReflected);
-  printf("Absorbed beams  %3d x %3d = %3d\n",
-         g_tScore.iAbsorbed,
-         SCORE_ABSORBED ,
-         SCORE_ABSORBED * g_tScore.iAbsorbed);
-  printf("----------------------------------\n");
-  printf("Sum total                 = %3d\n",
-         SCORE_ATOM      * g_tScore.iMissedAtoms +
-         SCORE_EXIT      * g_tScore.iExited      +
-         SCORE_REFLECTED * g_tScore.iReflected   +
-         SCORE_ABSORBED  * g_tScore.iAbsorbed);
+void stopShards(t_shard* patShards, int iShards) {
+  t_request tReq = {REQ_STOP, 0, 0};
+
+  for (int t = 0; t < iShards; ++t) {
+    pushRequest(&patShards[t], 0, &tReq);
+    wakeShard(&patShards[t]);
+  }
+
+  for (int t = 0; t < iShards; ++t) {
+    pthread_join(patShards[t].tThread, NULL);
+    for (int i = 0; i < patShards[t].iSessions; ++i)
+      freeBoard(&patShards[t].patBoards[i]);
+    for (int q = 0; q < patShards[t].iQueues; ++q)
+      free(patShards[t].patQueues[q].patRing);
+    free(patShards[t].patBoards);
+    free(patShards[t].patQueues);
+    close(patShards[t].iEpoll);
+    close(patShards[t].iWake);
+  }
+}
+
+/*******************************************************************************
+ * Name:  runServer
+ * Purpose: Hosts many games at once. Accepts connections and hands them over
+ *          to the shards in turn, which serve them from then on.
+ *******************************************************************************/
+void runServer(const char* pcAddr) {
+  t_rand    tRand     = {0};
+  t_request tReq      = {0};
+  int       iListen   = openListener(pcAddr);
+  int       iShards   = g_tOpts.iThreads;
+  int       iNext     = 0;
+  t_shard*  patShards = NULL;
+
+  randSeed(&tRand, (uint64_t) g_tOpts.llSeed);
+  patShards = startShards(iShards, 1, 0, &tRand);
+
+  printf("# serving on %s, size %d, atoms %d, shards %d, seed %lld\n",
+         pcAddr, g_tOpts.iSize, g_tOpts.iAtomNo, iShards, g_tOpts.llSeed);
+  fflush(stdout);
+
+  while (1) {
+    tReq.iFd = accept(iListen, NULL, NULL);
+    if (tReq.iFd < 0) {
+      // Out of file descriptors, give the shards time to close some.
+      if (errno == EMFILE || errno == ENFILE)
+        usleep(1000);
+      continue;
+    }
+    fcntl(tReq.iFd, F_SETFL, fcntl(tReq.iFd, F_GETFL) | O_NONBLOCK);
+
+    pushRequest(&patShards[iNext], 0, &tReq);
+    wakeShard(&patShards[iNext]);
+    iNext = (iNext + 1) % iShards;
+  }
+}
+
+/*******************************************************************************
+ * Name:  loadProbes
+ * Purpose: Thread's work, fires random probes into random load sessions and
+ *          routes each to the shard owning the session.
+ *******************************************************************************/
+void* loadProbes(void* pvLoader) {
+  t_loader* ptLoad     = (t_loader*) pvLoader;
+  int*      paiPending = (int*) calloc((size_t) ptLoad->iShards, sizeof(int));
+  t_request tReq       = {REQ_PROBE, 0, 0};
+  t_rand    tRand      = ptLoad->tRand;
+  int       iShard     = 0;
+
+  for (ll i = 0; i < ptLoad->llProbes; ++i) {
+    tReq.iSession = (int) randBelow(&tRand, LOAD_SESSIONS);
+    tReq.iEntry   = (int) randBelow(&tRand, (uint64_t) (4 * g_tOpts.iSize)) + 1;
+    iShard        = tReq.iSession % ptLoad->iShards;
+
+    // The shard knows its sessions by their index in its own list.
+    tReq.iSession /= ptLoad->iShards;
+    pushRequest(&ptLoad->patShards[iShard], ptLoad->iQueue, &tReq);
+
+    // Wake up in batches, each wake up is a system call.
+    if (++paiPending[iShard] == LOAD_BATCH) {
+      wakeShard(&ptLoad->patShards[iShard]);
+      paiPending[iShard] = 0;
+    }
+  }
+
+  for (int t = 0; t < ptLoad->iShards; ++t)
+    if (paiPending[t] != 0)
+      wakeShard(&ptLoad->patShards[t]);
+
+  ptLoad->tRand = tRand;
+  free(paiPending);
+
+  return NULL;
+}
+
+/*******************************************************************************
+ * Name:  runLoad
+ * Purpose: Drives the shards with probes from one load thread per shard and
+ *          prints their throughput.
+ *******************************************************************************/
+void runLoad(void) {
+  int             iShards   = g_tOpts.iThreads;
+  t_rand          tRand     = {0};
+  t_shard*        patShards = NULL;
+  t_loader*       patLoad   = (t_loader*) calloc((size_t) iShards, sizeof(t_loader));
+  struct timespec tStart    = {0};
+  struct timespec tEnd      = {0};
+  double          dSecs     = 0.0;
+  ll              llProbes  = 0;
+  t_probeCounts*  ptCounts  = NULL;
+
+  randSeed(&tRand, (uint64_t) g_tOpts.llSeed);
+  patShards = startShards(iShards, iShards, LOAD_SESSIONS, &tRand);
+
+  clock_gettime(CLOCK_MONOTONIC, &tStart);
+
+  for (int t = 0; t < iShards; ++t) {
+    patLoad[t].iQueue    = t;
+    patLoad[t].llProbes  = g_tOpts.llLoad / iShards + (t < g_tOpts.llLoad % iShards);
+    patLoad[t].tRand     = tRand;
+    randJump(&tRand);
+    patLoad[t].iShards   = iShards;
+    patLoad[t].patShards = patShards;
+    if (pthread_create(&patLoad[t].tThread, NULL, loadProbes, &patLoad[t]) != 0)
+      dispatchError(ERR_ELSE, "Can't create thread");
+  }
+
+  // Only after all probes are pushed, the shards may stop.
+  for (int t = 0; t < iShards; ++t)
+    pthread_join(patLoad[t].tThread, NULL);
+
+  // Counts are read after the shards' threads are joined.
+  stopShards(patShards, iShards);
+
+  clock_gettime(CLOCK_MONOTONIC, &tEnd);
+  dSecs = (double) (tEnd.tv_sec - tStart.tv_sec) + (double) (tEnd.tv_nsec - tStart.tv_nsec) / 1e9;
+
+  printf("# load probes %lld, sessions %d, size %d, atoms %d, shards %d, seed %lld\n",
+         g_tOpts.llLoad, LOAD_SESSIONS, g_tOpts.iSize, g_tOpts.iAtomNo, iShards, g_tOpts.llSeed);
+  printf("# shard probes absorbed reflected exited\n");
+  for (int t = 0; t < iShards; ++t) {
+    ptCounts = &patShards[t].tCounts;
+    printf("%d %lld %lld %lld %lld\n", t, ptCounts->llProbes, ptCounts->llAbsorbed, ptCounts->llReflected,
+           ptCounts->llProbes - ptCounts->llAbsorbed - ptCounts->llReflected);
+    llProbes += ptCounts->llProbes;
+  }
+  printf("# %lld probes in %.3f s = %.0f probes/s\n", llProbes, dSecs, (double) llProbes / dSecs);
+
+  free(patShards);
+  free(patLoad);
 }
 
 
@@ -734,12 +6162,13 @@ void printScore(void) {
 //* main
 
 int main(int argc, char *argv[]) {
-  cstr csAnswer   = csNew("");
-  int  iDirection = 0;
-  int  iCellEntry = 0;
-  int  iCellExit  = 0;
-  int  iNodeExit  = 0;
-  int  bEndOfLoop = 0;
+  cstr    csAnswer   = csNew("");
+  int     iNodeEntry = 0;
+  int     iNodeExit  = 0;
+  int     bEndOfLoop = 0;
+  t_rand  tRand      = {0};
+  t_probe tProbe     = {0};
+  int*    paiGuesses = NULL;
 
   // Save program's name.underlined
   g_csMename = csNew("");
@@ -748,21 +6177,96 @@ int main(int argc, char *argv[]) {
   // Get options and dispatch errors, if any.
   getOptions(argc, argv);
 
-  printIntro();
-  createBoard();
+  // No game play at all, just sum up the records.
+  if (g_tOpts.bReplay) {
+    runReplay(g_tOpts.csReplay.cStr);
+    return ERR_NOERR;
+  }
+
+  // No game play at all, just index records or look them up.
+  if (g_tOpts.bIndex) {
+    runIndex(g_tOpts.csIndex.cStr);
+    return ERR_NOERR;
+  }
+  if (g_tOpts.bFind) {
+    runFind(g_tOpts.csFind.cStr);
+    return ERR_NOERR;
+  }
+  if (g_tOpts.bEnumerate) {
+    runEnumeration(g_tOpts.csEnumerate.cStr);
+    return ERR_NOERR;
+  }
+
+  if (g_tOpts.csRecord.len != 0)
+    g_hRecord = openFile(g_tOpts.csRecord.cStr, "ab");
+
+  // No game play at all, just replay the batch file.
+  if (g_tOpts.bBatch) {
+    runBatch(g_tOpts.csBatch.cStr);
+    return ERR_NOERR;
+  }
+
+  // No game play at all, just hosting games of others.
+  if (g_tOpts.bServe) {
+    runServer(g_tOpts.csServe.cStr);
+    return ERR_NOERR;
+  }
+
+  // No game play at all, just the server's engine under load.
+  if (g_tOpts.llLoad > 0) {
+    runLoad();
+    return ERR_NOERR;
+  }
+
+  // No game play at all, just statistics.
+  if (g_tOpts.llSimulate > 0) {
+    runSimulation();
+    return ERR_NOERR;
+  }
+
+  // Events take stdout, before anything is printed.
+  if (g_tOpts.iFormat != FORMAT_TEXT)
+    initEvents(&g_tEvents, g_tOpts.iFormat);
+
+  // The terminal UI clears the screen, no need for the intro then.
+  if (g_tOpts.bTui && !initTui(&g_tTui, g_tOpts.iSize)) {
+    printf("No terminal or board doesn't fit into it, '--tui' is off ...\n\n");
+    g_tOpts.bTui = 0;
+  }
+  if (!g_tOpts.bTui)
+    printIntro();
+  randSeed(&tRand, (uint64_t) g_tOpts.llSeed);
+  initBoard(&g_tBoard, g_tOpts.iSize, g_tOpts.iAtomNo, g_tOpts.bBitboard);
+  createBoard(&g_tBoard, &tRand);
+  createExitTable(&g_tBoard);
+  initMarks(&g_tMarks, g_tOpts.iSize);
+  initScorer(&g_tScorer, &g_tOpts.atRules[0]);
+  startScore(&g_tScorer, g_tOpts.iSize);
+  eventBoard(&g_tEvents, g_tOpts.llSeed, g_tOpts.iSize, g_tOpts.iAtomNo);
+  daInit(t_probe, g_tProbes);
 
   // Make sure to print the board at least once prior game play, here or in the
-  // while loop.
-  if (!g_tOpts.bPrtBrd)
-    printBoard(BOARD_NEUTRAL);
+  // while loop. The terminal UI draws it just once.
+  if (g_tOpts.bTui)
+    drawTui(&g_tTui, &g_tBoard, BOARD_NEUTRAL, &g_tMarks);
+  else if (!g_tOpts.bPrtBrd)
+    printBoard(&g_tBoard, BOARD_NEUTRAL, &g_tMarks);
 
   while (!bEndOfLoop) {
-    if (g_tOpts.bPrtBrd)
-      printBoard(BOARD_NEUTRAL);
+    if (g_tOpts.bTui)
+      ;  // Prompt right below the last outcome.
+    else if (g_tOpts.bPrtBrd)
+      printBoard(&g_tBoard, BOARD_NEUTRAL, &g_tMarks);
     else
       printf("\n");
 
-    csAnswer = getEntryNode(&iCellEntry, &iDirection);
+    // Events so far are out, before waiting for the next beam.
+    syncEvents(&g_tEvents);
+    csAnswer = getEntryNode(&iNodeEntry);
+
+    // Outcome and messages replace the last ones below the board.
+    if (g_tOpts.bTui)
+      clearStatus(&g_tTui, &g_tBoard, &g_tMarks);
 
     if (csAnswer.len == 0)  {
       printf("Not a number or command ...\n");
@@ -779,48 +6283,96 @@ int main(int argc, char *argv[]) {
     if (csAnswer.cStr[0] == 'q' ||
         csAnswer.cStr[0] == 'Q') {
       printf("Bye then ...\n");
+      flushEvents(&g_tEvents);
       exit(0);
     }
     if (csAnswer.cStr[0] == 'b' ||
         csAnswer.cStr[0] == 'B') {
-      printBoard(BOARD_NEUTRAL);
+      if (g_tOpts.bTui)
+        drawTui(&g_tTui, &g_tBoard, BOARD_NEUTRAL, &g_tMarks);
+      else
+        printBoard(&g_tBoard, BOARD_NEUTRAL, &g_tMarks);
+      continue;
+    }
+    if (csAnswer.cStr[0] == 's' ||
+        csAnswer.cStr[0] == 'S') {
+      solveProbes(&g_tSolver, g_tOpts.iSize, g_tOpts.iAtomNo,
+                  g_tProbes.pVal, (int) g_tProbes.sCount);
+      printSolver(&g_tSolver);
+      g_tTui.bDirty = 1;
+      continue;
+    }
+    if (csAnswer.cStr[0] == 'a' ||
+        csAnswer.cStr[0] == 'A') {
+      adviseProbes(&g_tSolver, g_tProbes.pVal, (int) g_tProbes.sCount, &tRand);
+      g_tTui.bDirty = 1;
       continue;
     }
 
-    if (iCellEntry == -1)  {
+    if (iNodeEntry == 0)  {
       printf("Beam out of bounds ...\n");
       continue;
     }
 
-    iCellExit = walkGrid(iCellEntry, iDirection);
+    iNodeExit = g_tBoard.paiExits[iNodeEntry];
+
+    // Keep beam for the solver.
+    tProbe.iEntry = iNodeEntry;
+    tProbe.iExit  = iNodeExit;
+    daAdd(t_probe, g_tProbes, tProbe);
+    addMark(&g_tMarks, iNodeEntry, iNodeExit);
+    scoreBeam(&g_tScorer, iNodeEntry, iNodeExit);
+    eventProbe(&g_tEvents, iNodeEntry, iNodeExit);
+
+    if (g_tOpts.bTui) {
+      markBeam(&g_tTui, &g_tMarks, iNodeEntry, iNodeExit);
+      flushTui(&g_tTui);
+    }
 
     printf("Beam ");
 
-    if (iCellExit == iCellEntry) {
+    if (iNodeExit == iNodeEntry) {
       printf("was reflected\n");
-      ++g_tScore.iReflected;
       continue;
     }
 
-    if (iCellExit == 0) {
+    if (iNodeExit == 0) {
       printf("was absorbed\n");
-      ++g_tScore.iAbsorbed;
       continue;
     }
 
-    iNodeExit = getExitNode(iCellExit);
     printf("exited at %d\n", iNodeExit);
-    ++g_tScore.iExited;
   }
 
-  getAtomAnswers();
-  printBoard(BOARD_SOLUTION);
+  paiGuesses = (int*) malloc(sizeof(int) * (size_t) (g_tOpts.iAtomNo + 1));
+  getAtomAnswers(&g_tBoard, paiGuesses);
+  endScore(&g_tScorer, g_tOpts.iAtomNo);
+  if (g_tOpts.bTui)
+    drawTui(&g_tTui, &g_tBoard, BOARD_SOLUTION, &g_tMarks);
+  else
+    printBoard(&g_tBoard, BOARD_SOLUTION, &g_tMarks);
   printScore();
+  eventScore(&g_tEvents, g_tScorer.ptRules, &g_tScorer.tScore);
+
+  if (g_hRecord != NULL)
+    writeRecord(g_hRecord, g_tOpts.llSeed, &g_tBoard, g_tProbes.pVal, (int) g_tProbes.sCount,
+                paiGuesses, g_tOpts.iAtomNo, &g_tScorer.tScore);
 
   // Free all used memory, prior end of program.
   csFree(&csAnswer);
   daFreeEx(g_tArgs, cStr);
-  free(g_paiGrid);
+  freeBoard(&g_tBoard);
+  freeSolver(&g_tSolver);
+  if (g_tOpts.bTui)
+    freeTui(&g_tTui);
+  daFree(g_tProbes);
+  freeMarks(&g_tMarks);
+  freeScorer(&g_tScorer);
+  if (g_tOpts.iFormat != FORMAT_TEXT)
+    freeEvents(&g_tEvents);
+  free(paiGuesses);
+  if (g_hRecord != NULL)
+    fclose(g_hRecord);
 
   return ERR_NOERR;
 }
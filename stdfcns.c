@@ -2,7 +2,7 @@
  ** Name: stdfcns.c
  ** Purpose:  Keeps standard functions in one place for better maintenance.
  ** Author: (JE) Jens Elstner
- ** Version: v0.10.8
+ ** Version: v0.11.0
  *******************************************************************************
  ** Date        User  Log
  **-----------------------------------------------------------------------------
@@ -32,6 +32,7 @@
  ** 01.07.2022  JE    Shortened switch with 'toupper()' in 'getHexLongParm()'.
  ** 25.07.2022  JE    Added '#define arraySize(arr)' to get elements count.
  ** 23.07.2023  JE    Now uses c_string.h  v0.21.5
+ ** 16.10.2026  JE    Added 'rand*()' family, a seedable xoshiro256** PRNG.
  *******************************************************************************/
 
 
@@ -91,6 +92,11 @@ typedef union u_char2Int{
   uint32_t uint32;
 } t_char2Int;
 
+// rand*() state of xoshiro256**, one per thread.
+typedef struct s_rand {
+  uint64_t aullState[4];
+} t_rand;
+
 
 //******************************************************************************
 //* Functions
@@ -548,3 +554,82 @@ void initTimeFunctions(void) {
   tzset();
 }
 
+/*******************************************************************************
+ * Name:  randRotl
+ * Purpose: Rotates a 64 bit integer left by iBits.
+ *******************************************************************************/
+static inline uint64_t randRotl(uint64_t ullX, int iBits) {
+  return (ullX << iBits) | (ullX >> (64 - iBits));
+}
+
+/*******************************************************************************
+ * Name:  randNext
+ * Purpose: Returns next 64 bit pseudo random number of xoshiro256**.
+ *******************************************************************************/
+static inline uint64_t randNext(t_rand* ptRand) {
+  uint64_t* s     = ptRand->aullState;
+  uint64_t  ullRv = randRotl(s[1] * 5, 7) * 9;
+  uint64_t  ullT  = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= ullT;
+  s[3]  = randRotl(s[3], 45);
+
+  return ullRv;
+}
+
+/*******************************************************************************
+ * Name:  randSeed
+ * Purpose: Sets state from a single seed, expanded by splitmix64.
+ *******************************************************************************/
+void randSeed(t_rand* ptRand, uint64_t ullSeed) {
+  uint64_t ullZ = 0;
+
+  for (int i = 0; i < 4; ++i) {
+    ullZ = (ullSeed += 0x9e3779b97f4a7c15ULL);
+    ullZ = (ullZ ^ (ullZ >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    ullZ = (ullZ ^ (ullZ >> 27)) * 0x94d049bb133111ebULL;
+    ptRand->aullState[i] = ullZ ^ (ullZ >> 31);
+  }
+}
+
+/*******************************************************************************
+ * Name:  randJump
+ * Purpose: Advances state by 2^128 numbers, to split off independent streams.
+ *******************************************************************************/
+void randJump(t_rand* ptRand) {
+  static const uint64_t aullJump[] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                      0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+  uint64_t aullS[4] = {0};
+
+  for (int i = 0; i < 4; ++i) {
+    for (int b = 0; b < 64; ++b) {
+      if (aullJump[i] & (1ULL << b))
+        for (int j = 0; j < 4; ++j)
+          aullS[j] ^= ptRand->aullState[j];
+      randNext(ptRand);
+    }
+  }
+
+  for (int j = 0; j < 4; ++j)
+    ptRand->aullState[j] = aullS[j];
+}
+
+/*******************************************************************************
+ * Name:  randBelow
+ * Purpose: Returns an unbiased pseudo random number in [0, ullBound).
+ *******************************************************************************/
+static inline uint64_t randBelow(t_rand* ptRand, uint64_t ullBound) {
+  uint64_t ullLimit = -ullBound % ullBound;  // 2^64 mod bound.
+  uint64_t ullX     = 0;
+
+  // Reject the few numbers that would favour low results.
+  do {
+    ullX = randNext(ptRand);
+  } while (ullX < ullLimit);
+
+  return ullX % ullBound;
+}